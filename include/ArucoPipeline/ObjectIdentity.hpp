@@ -116,8 +116,14 @@ struct ObjectData
 
 	std::vector<ObjectData> Childs;
 
+	//Time that object ages are measured against : Clock::now(), or the time of the newest frame when simulated videos run on their own clock
+	static TimePoint Now();
+
+	//Set by the runner every tick when frame times don't follow the wall clock (scenario played once), an empty time point goes back to Clock::now()
+	static void SetSimulatedNow(TimePoint Time);
+
 	ObjectData(ObjectType InType = ObjectType::Unknown, const std::string InName = "None", 
-		cv::Affine3d InLocation = cv::Affine3d::Identity(), TimePoint InLastSeen = Clock::now())
+		cv::Affine3d InLocation = cv::Affine3d::Identity(), TimePoint InLastSeen = Now())
 		:type(InType), name(InName), location(InLocation), LastSeen(InLastSeen)
 	{}
 
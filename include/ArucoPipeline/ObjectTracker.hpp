@@ -34,6 +34,9 @@ public:
 
 	double GetArucoSize(int number);
 
+	//Smallest and largest side length of the tags owned by registered objects, returns false if no tag is registered
+	bool GetArucoSizeRange(double &MinSize, double &MaxSize) const;
+
 	std::vector<std::vector<cv::Point3d>> GetPointsOfInterest() const;
 
 private:
@@ -22,5 +22,14 @@ public:
 
 	virtual std::vector<ObjectData> ToObjectData() const override;
 
+	//Extent of the table on the ground, centered on the origin like the tags of the "Board"
+	static cv::Rect2d GetBoardArea();
+
+	//Outline of the table at that height, as a closed polygon
+	static std::vector<cv::Point3d> GetBoardOutline(double Height = 0);
+
+	//Heights where tags and what stands on the table can be seen : the table top and the top of the robots
+	static const std::vector<double>& GetTableHeights();
+
 	//virtual cv::Affine3d GetObjectTransform(const CameraFeatureData& CameraData, float& Surface, float& ReprojectionError) override;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <string>
 #include <opencv2/core.hpp>
 #include <filesystem>
+#include <nlohmann/json.hpp>
 #include <Cameras/ImageTypes.hpp>
 
 std::string GetCalibrationFileName(std::string description);
@@ -13,4 +14,10 @@ bool readCameraParameters(std::filesystem::path path, CameraSettings &Settings);
 
 void writeCameraParameters(std::filesystem::path path, const CameraSettings &Settings);
 
+//Calibration of the camera at its current resolution, as stored in json calibration files
+nlohmann::json CameraParametersToJson(const CameraSettings &Settings);
+
+//Read the calibration matching the current resolution from a json calibration object
+bool JsonToCameraParameters(const nlohmann::json &object, CameraSettings &Settings);
+
 void MigrateCameraParameters();
\ No newline at end of file
@@ -6,15 +6,24 @@
 #include <vector>
 #include <chrono>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <opencv2/core.hpp>		// Basic OpenCV structures (Mat, Scalar)
 #include <opencv2/core/affine.hpp>
 
 #include <Cameras/ImageSource.hpp>
 #include <Cameras/ImageTypes.hpp>
+#include <Cameras/UndistortionMaps.hpp>
+#include <Cameras/FrameChanges.hpp>
 #include <ArucoPipeline/TrackedObject.hpp>
+#include <Misc/FrameMailbox.hpp>
+#include <Misc/LatencyEstimator.hpp>
+#include <Misc/FramePool.hpp>
 
 class Camera;
 struct CameraImageData;
+class FrameRecorder;
 
 template<class CameraClass>
 std::vector<CameraClass*> StartCameras(std::vector<CameraSettings> CameraSettings)
@@ -47,13 +56,39 @@ protected:
 	std::string Name;
 	bool HasUndistortionMaps;
 	
-	cv::UMat UndistMap1, UndistMap2;
+	std::shared_ptr<const UndistortionMaps> UndistMaps;
 	cv::UMat LastFrameDistorted, LastFrameUndistorted;
+	std::shared_ptr<SparseUndistortedFrame> LastFrameSparseUndistorted;
+	cv::UMat LastFrameGray;
+	int LastFrameGrayScale;
+	cv::Mat LastFrameCompressed;
+	//0 to decode colour, otherwise only the luma is decoded, at 1/LumaOnlyScale resolution
+	std::atomic<int> LumaOnlyScale;
+	//Frames are being recorded, the compressed frame is kept so that it's written as is
+	std::atomic<bool> KeepCompressed;
+
+	//Threaded capture : the capture thread keeps decoding frames into the mailbox, Read only takes the newest one
+	std::unique_ptr<std::thread> CaptureThread;
+	std::atomic<bool> CaptureThreadKilled;
+	FrameMailbox<CameraImageData> CaptureMailbox;
+
+	//Time between the exposure of a frame and when Read makes it available
+	LatencyEstimator CaptureLatency;
+
+	//Frames of one format that can be alive at once : capture mailbox, last frame, triple buffered ImageData and a copy sent to clients
+	static constexpr size_t FramePoolDepth = 8;
+	//Buffers for decoded and undistorted frames
+	FramePool FrameBuffers;
+
+	FrameChangeTracker ChangeTracker;
+	std::shared_ptr<const FrameChanges> LastFrameChanges;
+	unsigned int LastFrameChangesNumber;
 public:
-	int errors;
+	std::atomic<int> errors;
 	//status
 	bool connected;
 	bool grabbed;
+	std::atomic<bool> ended; //the file being played back has no frames left, the camera can be detached. Set from the capture thread when threaded
 	unsigned int FrameNumber;
 	std::chrono::steady_clock::time_point captureTime;
 
@@ -64,18 +99,55 @@ public:
 	Camera(std::shared_ptr<CameraSettings> InSettings)
 		:TrackedObject(), Settings(InSettings),
 		HasUndistortionMaps(false),
+		LastFrameGrayScale(1),
+		LumaOnlyScale(0),
+		KeepCompressed(false),
+		CaptureThreadKilled(false),
+		FrameBuffers(FramePoolDepth),
+		LastFrameChangesNumber(-1),
 		errors(0),
 		connected(false),
+		ended(false),
 		FrameNumber(-1),
 		PositionLocked(false)
 	{}
 
 	virtual ~Camera()
-	{}
+	{
+		StopCaptureThread();
+	}
 
 protected:
 	void RegisterError();
 	void RegisterNoError();
+
+	//Grab and decode a frame into Frame, blocking. Called from the capture thread.
+	//Must not touch LastFrameDistorted or LastFrameUndistorted, they belong to the detection thread
+	virtual bool CaptureFrame(CameraImageData &Frame);
+
+	void CaptureThreadEntryPoint();
+
+	//Decode a compressed frame into a buffer from the frame pool. ExpectedSize is the size the decoder should output
+	bool DecodeToPool(const cv::Mat &Compressed, int Flags, cv::Size ExpectedSize, cv::UMat &Target);
+
+	//Decode a compressed frame into Frame.Image or Frame.GrayImage, depending on the decode mode
+	bool DecodeCompressed(const cv::Mat &Compressed, CameraImageData &Frame);
+
+	//True if the compressed frame must outlive the backend's buffer : for deferred colour decoding or for recording
+	//Backends that only borrow the compressed data only copy it then
+	bool NeedsCompressedCopy() const
+	{
+		return LumaOnlyScale != 0 || KeepCompressed;
+	}
+
+	//Make Frame the last frame, returned by GetFrame
+	void SetLastFrame(const CameraImageData &Frame);
+
+	//Create the undistortion maps if needed, returns false if the calibration is invalid
+	bool PrepareUndistortionMaps();
+
+	//Set the capture time of the last frame from the driver's timestamp, and feed the latency estimator
+	void SetCaptureTime(std::chrono::steady_clock::time_point Time);
 public:
 
 	std::string GetName()
@@ -101,18 +173,76 @@ public:
 
 	void UpdateFrameNumber();
 
+	//Start a thread that captures frames continuously, Grab and Read then never block
+	//Derived classes must call StopCaptureThread in their destructor, before releasing their feed
+	void StartCaptureThread();
+
+	void StopCaptureThread();
+
+	bool IsCaptureThreaded() const
+	{
+		return CaptureThread != nullptr;
+	}
+
+	//True if the capture thread has a frame that Read has not taken yet
+	bool HasNewFrame() const;
+
+	//Notified whenever the capture thread of any camera has a new frame
+	static MailboxSignal& GetNewFrameSignal();
+
+	FramePool::Stats GetFramePoolStats() const
+	{
+		return FrameBuffers.GetStats();
+	}
+
+	//Only valid for backends that provide capture timestamps
+	const LatencyEstimator& GetCaptureLatency() const
+	{
+		return CaptureLatency;
+	}
+
 	//Lock a frame to be capture at this time
 	//This allow for simultaneous capture
+	//When threaded, does nothing and returns HasNewFrame
 	virtual bool Grab();
 
 	//Retrieve or read a frame
+	//When threaded, takes the newest frame from the capture thread, returns false without error if there is none
 	virtual bool Read();
 
+	//Choose how compressed frames are decoded. In luma only mode, only a gray image at 1/ScaleDenominator resolution (1, 2, 4 or 8) is produced,
+	//the colour image is then only decoded when DecodeColor is called. Backends that don't receive compressed frames always decode colour.
+	void SetDecodeMode(bool LumaOnly, int ScaleDenominator = 1);
+
+	//Keep the compressed frames from the camera, so that recording writes them as is instead of encoding the colour image
+	void SetKeepCompressed(bool Keep)
+	{
+		KeepCompressed = Keep;
+	}
+
+	//Make sure the colour image of the last frame is available, decoding it if needed
+	bool DecodeColor();
+
 	virtual void Undistort();
 
+	//Undistort the last frame on demand : GetFrame(false) then returns a frame where only the regions that are used get remapped
+	//Uses the full resolution luma when available. Cached until the next frame, Undistort can still be called for a full colour frame
+	void UndistortSparse();
+
+	//Compare the last frame to the previous ones on a downsampled grid, GetFrame(true) then hands the result to the detectors
+	//Uses the luma when available. Call once per frame after Read, frames it wasn't called for have no changes and are processed entirely
+	void UpdateFrameChanges();
+
+	std::shared_ptr<const FrameChanges> GetFrameChanges() const
+	{
+		return LastFrameChangesNumber == FrameNumber ? LastFrameChanges : nullptr;
+	}
+
 	virtual CameraImageData GetFrame(bool Distorted) const override;
 
 	virtual std::vector<ObjectData> ToObjectData() const override;
 
-	virtual void Record(std::filesystem::path rootPath, int RecordIdx);
+	//Save the last frame. When a recorder is given, the frame is only queued and written in the background
+	//The compressed frame from the camera is saved as is when there is one, otherwise the colour image is encoded
+	virtual void Record(std::filesystem::path rootPath, int RecordIdx, FrameRecorder* Recorder = nullptr);
 };
\ No newline at end of file
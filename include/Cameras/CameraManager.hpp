@@ -6,6 +6,7 @@
 #include <iostream>
 #include <shared_mutex>
 #include <memory>
+#include <atomic>
 
 #include <Cameras/Camera.hpp>
 #include <Transport/Task.hpp>
@@ -28,6 +29,12 @@ protected:
 
 	bool Idle = false;
 
+	//Set when the devices have to be scanned again even if none was plugged or unplugged (camera detached, idle exited)
+	std::atomic<bool> ScanRequested{true};
+
+	//Set when no camera will ever be started again (scenario played once)
+	std::atomic<bool> Finished{false};
+
 public:
 	//Function called when a new camera is to be created. Return nullptr if you want to veto that creation
 	//Will be called in a separate thread 
@@ -52,6 +59,11 @@ public:
 		return Idle;
 	}
 
+	bool HasFinished() const
+	{
+		return Finished;
+	}
+
 public:
 	//Call Tick to remove misbehaving cameras and get the current cameras
 	virtual std::vector<Camera*> Tick();
@@ -59,5 +71,10 @@ public:
 	std::vector<Camera*> GetCameras();
 
 protected:
+	void RequestScan()
+	{
+		ScanRequested = true;
+	}
+
 	virtual void ThreadEntryPoint() override;
 };
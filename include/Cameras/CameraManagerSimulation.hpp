@@ -19,5 +19,8 @@ public:
 	}
 
 protected:
+	//Start a replay camera for each camera of a recording file
+	void StartRecordingCameras(std::filesystem::path RecordingPath, const std::vector<unsigned int> &CameraLockToggles);
+
 	virtual void ThreadEntryPoint() override;
 };
@@ -29,5 +29,15 @@ public:
 	static std::vector<VideoCaptureCameraSettings> autoDetectCameras(CameraStartType Start, std::string Filter, bool silent = true);
 
 protected:
+	//Start the cameras that are not used or blocked yet
+	void ScanDevices();
+
+	//Read the pending inotify events, returns true if a video device was added or removed
+	bool ReadDeviceEvents(int InotifyFd);
+
+	//Wait for video devices to be added or removed in /dev, returns true if a scan is needed
+	//Paths of the devices that changed are unblocked, so that a replugged camera is tried again
+	bool WaitForDeviceEvents(int InotifyFd, std::chrono::milliseconds Timeout);
+
 	virtual void ThreadEntryPoint() override;
 };
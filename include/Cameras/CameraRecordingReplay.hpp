@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <chrono>
+
+#include <Cameras/Camera.hpp>
+#include <Cameras/ImageTypes.hpp>
+#include <Cameras/RecordingFile.hpp>
+#include <Misc/GlobalConf.hpp>
+
+//Camera that replays one camera of a recording file (see RecordingFile.hpp)
+//Every frame is read in order, decoded straight from the mapped file, and timestamped from its recorded grab time
+//When playing in real time, reading a frame waits until its timestamp
+//Settings->StartPath is the recording, DeviceInfo.device_description the name of the recorded camera
+class CameraRecordingReplay : public Camera
+{
+private:
+	std::shared_ptr<RecordingReader> Recording;
+	const RecordedCamera* Recorded = nullptr;
+	size_t NextFrame = 0;
+	std::chrono::steady_clock::time_point PlaybackStart;
+	SimulationClock Clock = SimulationClock::Loop;
+
+public:
+	CameraRecordingReplay(std::shared_ptr<VideoCaptureCameraSettings> InSettings)
+		:Camera(InSettings)
+	{
+	}
+
+	~CameraRecordingReplay()
+	{
+		StopCaptureThread();
+	}
+
+	//Index of the recorded frame that was replayed with that grab time, the size of the recording if there is none
+	size_t FindRecordedFrame(std::chrono::steady_clock::time_point GrabTime) const;
+
+	//Lock the camera at the pose of that frame, when it was locked during the recording
+	void ApplyRecordedPose(size_t FrameIndex);
+
+protected:
+	virtual bool CaptureFrame(CameraImageData &Frame) override;
+
+public:
+	//Open the recording and find the camera in it
+	virtual bool StartFeed() override;
+
+	virtual bool Grab() override;
+
+	//Decode the next recorded frame, or take the one of the capture thread
+	//Recorded poses are applied to the frame being read when the camera was locked during the recording
+	virtual bool Read() override;
+};
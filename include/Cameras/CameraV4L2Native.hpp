@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <opencv2/core.hpp>
+
+#include <Cameras/Camera.hpp>
+#include <Cameras/ImageTypes.hpp>
+#include <thirdparty/list-devices.hpp>
+
+//Camera that talks to V4L2 directly, without cv::VideoCapture
+//Uses mmap streaming with a ring of driver buffers, MJPEG buffers are decoded straight from the mapped memory
+//Supports luma only decoding (see Camera::SetDecodeMode)
+class CameraV4L2Native : public Camera
+{
+private:
+	struct MappedBuffer
+	{
+		void* start = nullptr;
+		size_t length = 0;
+	};
+
+	int fd = -1;
+	std::vector<MappedBuffer> Buffers;
+	//buffer dequeued by Grab and not yet read
+	v4l2_buffer GrabbedBuffer;
+	bool HasGrabbedBuffer = false;
+
+	bool Dequeue(v4l2_buffer &buf);
+	bool Enqueue(int index);
+	bool Decode(const v4l2_buffer &buf, CameraImageData &Frame);
+	void StopFeed();
+
+public:
+
+	CameraV4L2Native(std::shared_ptr<VideoCaptureCameraSettings> InSettings)
+		:Camera(InSettings)
+	{
+	}
+
+	~CameraV4L2Native();
+
+protected:
+	virtual bool CaptureFrame(CameraImageData &Frame) override;
+
+public:
+	//Start the camera
+	virtual bool StartFeed() override;
+
+	//Dequeue a buffer from the driver
+	virtual bool Grab() override;
+
+	//Decode the dequeued buffer and give it back to the driver
+	virtual bool Read() override;
+};
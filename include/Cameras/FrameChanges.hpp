@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <opencv2/core.hpp>
+
+//Which parts of a camera's frames changed, on a grid of cells downsampled from the frame
+//Handed to the detectors with each frame (see CameraImageData::Changes), so that they can reuse their previous results where nothing moved
+struct FrameChanges
+{
+	int FrameIndex = 0; //index of the frame this was computed for, counting from 1
+	cv::Size FrameSize; //full resolution frame size
+	int CellSize = 1; //pixels of the full frame per cell side
+	cv::Mat LastChange; //CV_32SC1, per cell : index of the last frame where the cell changed
+
+	//True if any cell covering Region changed after the frame SinceFrame. Region is in full resolution pixels
+	bool HasChangedSince(cv::Rect Region, int SinceFrame) const;
+};
+
+//Builds the FrameChanges of a camera, frame after frame
+//Each cell keeps its value from when it last changed, so slow drifts are caught once they add up to the threshold
+class FrameChangeTracker
+{
+private:
+	cv::UMat Small;
+	cv::Mat Reference; //CV_8UC1, mean luma of each cell when it last changed
+	cv::Mat LastChange;
+	int FrameIndex = 0;
+
+public:
+	static constexpr int CellSize = 16;
+	//Difference of mean luma for a cell to count as changed
+	static constexpr int ChangeThreshold = 6;
+
+	//Source is the gray or BGR frame, at any scale of FrameSize
+	std::shared_ptr<const FrameChanges> Update(const cv::UMat &Source, cv::Size FrameSize);
+};
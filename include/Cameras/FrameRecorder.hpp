@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <filesystem>
+#include <opencv2/core.hpp>
+
+#include <opencv2/core/affine.hpp>
+
+#include <Misc/GlobalConf.hpp>
+#include <Cameras/ImageTypes.hpp>
+#include <Cameras/RecordingFile.hpp>
+
+//A frame to write to disk
+struct RecordingJob
+{
+	std::filesystem::path Path; //file to write to when not recording to a recording file
+	cv::UMat Image; //encoded to jpeg if Compressed is empty
+	cv::Mat Compressed; //jpeg as received from the camera, written as is
+
+	//Only used by recording files
+	std::string CameraName;
+	std::shared_ptr<const CameraSettings> Settings;
+	std::chrono::steady_clock::time_point GrabTime;
+	uint32_t FrameNumber = 0;
+	cv::Affine3d Pose;
+	bool PositionLocked = false;
+};
+
+//Writes frames to disk in the background, so that recording doesn't stall the detection
+//Frames are queued by reference, the queue is bounded and frames are dropped following the drop policy when it's full
+class FrameRecorder
+{
+public:
+	struct Stats
+	{
+		uint64_t Written = 0;
+		uint64_t Dropped = 0;
+		uint64_t Failed = 0;
+		size_t QueueDepth = 0;
+		size_t MaxQueueDepth = 0; //since the recorder was created
+	};
+
+private:
+	std::deque<RecordingJob> Queue;
+	mutable std::mutex QueueMutex;
+	std::condition_variable JobAvailable, SpaceAvailable;
+	std::vector<std::unique_ptr<std::thread>> Encoders;
+	bool Stopping = false;
+
+	size_t MaxQueueSize;
+	RecordDropPolicy DropPolicy;
+
+	uint64_t Written = 0, Dropped = 0, Failed = 0;
+	size_t MaxQueueDepth = 0;
+
+	//When set, all frames go to this file instead of their own jpeg
+	std::unique_ptr<RecordingWriter> Container;
+
+	void EncoderThreadEntryPoint();
+
+	bool WriteToContainer(const RecordingJob &Job);
+
+public:
+	//If ContainerPath is not empty, frames are appended to that recording file
+	FrameRecorder(size_t InMaxQueueSize, int NumEncoders, RecordDropPolicy InDropPolicy, std::filesystem::path ContainerPath = {});
+
+	//Uses the recording config
+	FrameRecorder(std::filesystem::path ContainerPath = {});
+
+	//Writes what's left in the queue before returning
+	~FrameRecorder();
+
+	//Write a frame right away, on the calling thread
+	static bool WriteJob(const RecordingJob &Job);
+
+	//Queue a frame to be written, returns false if it was dropped
+	bool Enqueue(RecordingJob Job);
+
+	Stats GetStats() const;
+
+	//Print the written, dropped and failed counts and the queue depth
+	void PrintStats() const;
+};
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <filesystem>
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/core/affine.hpp>
@@ -33,6 +35,8 @@ struct CameraSettings
 
 	//single lens settings, for side-by-side cams
 	std::vector<LensSettings> Lenses;
+	//File the lenses were read from, empty if they were not read from a file. Undistortion maps are cached next to it
+	std::filesystem::path CalibrationFile;
 
 
 	//Frame number at which to toggle camera position lock (camera always starts unlocked, used for simulation)
@@ -63,7 +67,9 @@ enum class CameraStartType
 {
 	ANY = 0,
 	GSTREAMER_CPU,
-	PLAYBACK //playback from a file
+	PLAYBACK, //playback from a file
+	V4L2_NATIVE, //direct V4L2 mmap streaming, see CameraV4L2Native
+	RECORDING //replay of a recording file, see CameraRecordingReplay
 };
 
 struct VideoCaptureCameraSettings : public CameraSettings
@@ -80,13 +86,28 @@ struct VideoCaptureCameraSettings : public CameraSettings
 	int ApiID;
 };
 
+class SparseUndistortedFrame;
+struct FrameChanges;
+
 struct CameraImageData
 {
 	std::string CameraName;
-	cv::UMat Image;
+	cv::UMat Image; //Colour image, can be empty when the camera only decoded the luma (see Camera::SetDecodeMode)
+	cv::UMat GrayImage; //Luma decoded straight from the compressed frame, at 1/GrayScaleDenominator resolution. Can be empty
+	int GrayScaleDenominator = 1;
+	cv::Mat Compressed; //Compressed frame as received from the camera, empty if the backend does not provide it
+	cv::Size FrameSize; //Size of the full resolution frame, even if Image was not decoded
+	std::shared_ptr<SparseUndistortedFrame> SparseUndistorted; //Undistorted frame remapped on demand, set when Image is not undistorted (see Camera::UndistortSparse)
+	std::shared_ptr<const FrameChanges> Changes; //Cells that changed since the previous frames, only on distorted frames when the camera tracks them (see Camera::UpdateFrameChanges)
 
 	std::vector<LensSettings> lenses;
-	std::chrono::steady_clock::time_point GrabTime;
+	std::chrono::steady_clock::time_point GrabTime; //When the frame was exposed, from the driver's timestamp when available
+	double Latency = 0; //Estimated delay between exposure and the frame being available, seconds. Only meaningful with the native V4L2 backend, others stamp frames when they're read
 	bool Distorted;
 	bool Valid = false;
+
+	cv::Size GetFrameSize() const
+	{
+		return Image.empty() ? FrameSize : Image.size();
+	}
 };
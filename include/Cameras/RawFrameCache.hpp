@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include <filesystem>
+#include <opencv2/core.hpp>
+
+//Every frame of a video, decoded once and stored raw (gray or BGR) next to the video, then memory mapped
+//Simulated cameras serve frames straight from the mapping, so that playback costs no decoding and benchmarks only measure the detectors
+//The cache is built the first time a video is played with the cache enabled, and rebuilt when the video changes
+//File layout : a header padded to a page, then the frames, each padded to a page. All values are little endian
+class RawFrameCache
+{
+public:
+	struct Header
+	{
+		char Magic[8];
+		uint32_t Version;
+		int32_t Type; //CV_8UC1 or CV_8UC3
+		int32_t Width, Height;
+		uint64_t FrameCount;
+		uint64_t FrameStride; //bytes between the start of two frames
+		double Framerate;
+		//size and modification time of the video the frames were decoded from
+		uint64_t SourceSize;
+		int64_t SourceTime;
+	};
+
+private:
+	std::filesystem::path Path;
+	uint8_t* Data = nullptr;
+	size_t Size = 0;
+	Header Info;
+
+	RawFrameCache(std::filesystem::path InPath);
+
+	//Map the cache file, returns false if it's missing, invalid or was decoded from another version of the video
+	bool Map(int Type, uint64_t SourceSize, int64_t SourceTime);
+
+public:
+	~RawFrameCache();
+
+	//Get the cache of that video, building it if needed. Type is CV_8UC1 for gray or CV_8UC3 for BGR
+	//Caches stay mapped until exit : frames handed out point into them and can outlive the camera that read them
+	//Returns nullptr if the video can't be decoded or the cache can't be written
+	static std::shared_ptr<RawFrameCache> Open(const std::filesystem::path &VideoPath, int Type);
+
+	size_t GetFrameCount() const
+	{
+		return Info.FrameCount;
+	}
+
+	cv::Size GetFrameSize() const
+	{
+		return cv::Size(Info.Width, Info.Height);
+	}
+
+	double GetFramerate() const
+	{
+		return Info.Framerate;
+	}
+
+	//Frame at that index, pointing into the mapping. Empty if out of range
+	cv::Mat GetFrame(size_t Index) const;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+#include <Cameras/ImageTypes.hpp>
+
+//Single file recording of a session : compressed frames from all cameras, with their grab time, camera pose and calibration
+//The file is append only : a header, then chunks (camera description or frame), then an index of all the chunks and a footer
+//pointing to the index. If the session was not closed properly the index is missing and is rebuilt by walking the chunks.
+//All values are little endian.
+namespace RecordingFormat
+{
+	constexpr char FileMagic[8] = {'C', 'Y', 'C', 'L', 'R', 'E', 'C', '\0'};
+	constexpr char FooterMagic[8] = {'C', 'Y', 'C', 'L', 'I', 'D', 'X', '\0'};
+	constexpr uint32_t Version = 1;
+
+	enum class ChunkType : uint32_t
+	{
+		Camera = 1, //json : name and calibration
+		Frame = 2, //FrameHeader then the jpeg
+		Index = 3 //IndexEntry for every chunk before it
+	};
+
+	enum FrameFlags : uint32_t
+	{
+		PositionLocked = 1 //the pose is the one the camera was locked to
+	};
+
+	struct FileHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t Reserved;
+	};
+
+	struct ChunkHeader
+	{
+		ChunkType Type;
+		uint32_t Camera;
+		uint64_t PayloadSize;
+	};
+
+	struct FrameHeader
+	{
+		int64_t GrabTime; //steady clock, ns
+		uint32_t FrameNumber;
+		uint32_t Flags;
+		double Pose[16]; //camera location, row major
+	};
+
+	struct IndexEntry
+	{
+		uint64_t Offset; //of the chunk header
+		ChunkType Type;
+		uint32_t Camera;
+		int64_t GrabTime; //frames only
+	};
+
+	struct Footer
+	{
+		uint64_t IndexOffset;
+		char Magic[8];
+	};
+};
+
+//Appends frames to a recording file
+//Thread safe
+class RecordingWriter
+{
+private:
+	std::ofstream File;
+	std::mutex Mutex;
+	uint64_t Offset = 0;
+	std::vector<RecordingFormat::IndexEntry> Index;
+	std::map<std::string, uint32_t> CameraIndices;
+
+	bool WriteChunk(RecordingFormat::ChunkType Type, uint32_t Camera, int64_t GrabTime,
+		const void* Header, size_t HeaderSize, const void* Data, size_t DataSize);
+
+public:
+	RecordingWriter(std::filesystem::path Path);
+
+	//Writes the index
+	~RecordingWriter();
+
+	bool IsOpen() const
+	{
+		return File.is_open();
+	}
+
+	//Index of the camera with that name, its calibration is written the first time it is seen
+	uint32_t GetCameraIndex(const std::string &Name, const CameraSettings &Settings);
+
+	bool AddFrame(uint32_t Camera, std::chrono::steady_clock::time_point GrabTime, uint32_t FrameNumber,
+		cv::Affine3d Pose, bool PositionLocked, const void* Jpeg, size_t JpegSize);
+
+	//Write the index and the footer, nothing can be added afterwards
+	void Close();
+};
+
+struct RecordedFrame
+{
+	std::chrono::steady_clock::time_point GrabTime;
+	uint32_t FrameNumber;
+	cv::Affine3d Pose;
+	bool PositionLocked;
+	cv::Mat Jpeg; //points into the mapped file
+};
+
+struct RecordedCamera
+{
+	std::string Name;
+	CameraSettings Settings;
+	std::vector<RecordedFrame> Frames; //sorted by grab time
+};
+
+//Memory mapped recording file, shared by the replay cameras of that file
+class RecordingReader
+{
+private:
+	std::filesystem::path Path;
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+	std::vector<RecordedCamera> Cameras;
+	std::chrono::steady_clock::time_point StartTime;
+
+	RecordingReader(std::filesystem::path InPath);
+
+	bool ReadIndex(std::vector<RecordingFormat::IndexEntry> &Index) const;
+	void RebuildIndex(std::vector<RecordingFormat::IndexEntry> &Index) const;
+	bool ReadChunks(const std::vector<RecordingFormat::IndexEntry> &Index);
+
+public:
+	~RecordingReader();
+
+	//Open a recording, or get the already opened one. Returns nullptr if it can't be read
+	static std::shared_ptr<RecordingReader> Open(std::filesystem::path Path);
+
+	const std::filesystem::path& GetPath() const
+	{
+		return Path;
+	}
+
+	const std::vector<RecordedCamera>& GetCameras() const
+	{
+		return Cameras;
+	}
+
+	//Grab time of the first frame of the recording, all cameras included
+	std::chrono::steady_clock::time_point GetStartTime() const
+	{
+		return StartTime;
+	}
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <filesystem>
+#include <opencv2/core.hpp>
+
+#include <Cameras/ImageTypes.hpp>
+
+//Fixed-point undistortion maps for a whole frame, ready to be used by cv::remap
+//Map1 is CV_16SC2 (integer source position), Map2 is CV_16UC1 (interpolation table index)
+struct UndistortionMaps
+{
+	cv::UMat Map1, Map2;
+};
+
+//Key identifying a calibration at a resolution : hash of the lenses and the resolution
+std::string GetUndistortionMapsKey(const std::vector<LensSettings> &Lenses, cv::Size Resolution);
+
+//Get the undistortion maps for these lenses
+//Maps are shared between all cameras that use the same calibration,
+//and cached on disk next to CalibrationFile so that they don't have to be computed again when a camera is restarted
+//When the calibration changes, the caches of the previous calibrations of that file at this resolution are removed
+//Returns nullptr if the lenses are invalid
+std::shared_ptr<const UndistortionMaps> GetUndistortionMaps(const std::vector<LensSettings> &Lenses, cv::Size Resolution,
+	std::filesystem::path CalibrationFile);
+
+//Undistorted frame that is only remapped where it is needed, tile by tile
+//Tiles are remapped once and kept for the lifetime of the frame, so it can be shared by every detector working on this frame
+//Thread safe
+class SparseUndistortedFrame
+{
+private:
+	std::shared_ptr<const UndistortionMaps> Maps;
+	cv::UMat Source, Destination;
+	unsigned int FrameNumber;
+	cv::Size TileSize, NumTiles;
+	std::vector<bool> TilesDone;
+	size_t NumTilesDone;
+	std::mutex Mutex;
+
+	//Remap the tiles in this range of tiles that were not remapped yet
+	void UndistortTiles(cv::Rect TileRange);
+
+public:
+	//Destination is the buffer to undistort into, reallocated if it doesn't have the size and type of Source
+	SparseUndistortedFrame(cv::UMat InSource, cv::UMat InDestination, std::shared_ptr<const UndistortionMaps> InMaps, unsigned int InFrameNumber,
+		cv::Size InTileSize = cv::Size(128, 128));
+
+	unsigned int GetFrameNumber() const
+	{
+		return FrameNumber;
+	}
+
+	cv::Size GetSize() const
+	{
+		return Source.size();
+	}
+
+	//Undistort the regions and return the whole undistorted frame
+	//Only the tiles covering these regions, and those requested before, hold valid data
+	cv::UMat GetRegions(const std::vector<cv::Rect> &Regions);
+
+	//Undistort what's left of the frame and return it
+	cv::UMat GetFull();
+};
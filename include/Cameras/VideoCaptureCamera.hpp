@@ -9,6 +9,7 @@
 
 #include <Cameras/Camera.hpp>
 #include <Cameras/ImageTypes.hpp>
+#include <Misc/GlobalConf.hpp>
 
 
 class VideoCaptureCamera : public Camera
@@ -19,6 +20,24 @@ private:
 	//capture using classic api
 	std::unique_ptr<cv::VideoCapture> feed;
 
+	//When the scenario is played once, frames are timestamped from their index and the framerate of the file, starting at the simulation epoch
+	//Looping playback and live cameras are timestamped when the frame is read
+	bool Playback = false;
+	std::chrono::steady_clock::time_point PlaybackStart;
+	SimulationClock Clock = SimulationClock::Loop;
+	size_t PlaybackFrameIndex = 0;
+	double PlaybackFramerate = 0;
+	//When set, frames are served from pre-decoded raw frames instead of feed
+	std::shared_ptr<class RawFrameCache> RawFrames;
+
+	std::chrono::steady_clock::time_point GetPlaybackTime() const;
+
+	//Timestamp the frame that was just read, and wait for its time when playing in real time
+	std::chrono::steady_clock::time_point AdvancePlayback();
+
+	//Next frame of RawFrames, without copy
+	bool ReadRawFrame(CameraImageData &Frame);
+
 public:
 
 	VideoCaptureCamera(std::shared_ptr<VideoCaptureCameraSettings> InSettings)
@@ -28,9 +47,14 @@ public:
 
 	~VideoCaptureCamera()
 	{
-		
+		StopCaptureThread();
 	}
 
+protected:
+	virtual bool CaptureFrame(CameraImageData &Frame) override;
+
+public:
+
 	//Start the camera
 	virtual bool StartFeed() override;
 
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <chrono>
 #include <opencv2/core.hpp>
 #include <opencv2/core/affine.hpp>
 #include <ArucoPipeline/ArucoTypes.hpp>
@@ -21,6 +22,9 @@ struct CameraFeatureData
 
 	cv::Affine3d CameraTransform; 	//Filled by CopyEssentials from CameraImageData
 	cv::Size FrameSize; 			//Filled by CopyEssentials from CameraImageData
+	double Latency = 0; 			//Filled by CopyEssentials from CameraImageData, seconds
+	cv::Mat ROIMask; 				//Filled by CDFRCommon from the camera location : CV_8UC1 at frame size, detectors skip the pixels that are 0. Empty to look everywhere
+	cv::Rect ROIBounds; 			//Filled by CDFRCommon, bounding box of ROIMask
 
 	std::vector<ArucoCornerArray> ArucoCorners, 		//Filled by ArucoDetect
 		ArucoCornersReprojected; 						//Cleared by ArucoDetect, Filled by ObjectTracker
@@ -28,6 +32,7 @@ struct CameraFeatureData
 	std::vector<cv::Rect> ArucoSegments;				//Filled by ArucoDetect
 
 	std::vector<YoloDetection> YoloDetections; 	//Filled by YoloDetect
+	std::chrono::steady_clock::time_point YoloGrabTime; //Filled by YoloDetect, grab time of the frame YoloDetections were found on
 
 	void Clear();
 	void CopyEssentials(const struct CameraImageData &source, int lens = 0);
@@ -6,11 +6,52 @@
 
 cv::UMat PreprocessArucoImage(cv::UMat Source);
 
+//Largest JPEG DCT scale (1, 2, 4 or 8) that does not go below the aruco reduction, for luma only decoding
+int GetArucoDecodeScale();
+
 std::vector<cv::Rect> GetPOIRects(const std::vector<std::vector<cv::Point3d>> &POIs, cv::Size framesize, 
 	cv::Affine3d CameraTransform, cv::InputArray CameraMatrix, cv::InputArray distCoeffs);
 
+//Corner refinement of the reduced resolution detection (DetectAruco), summed since startup
+struct CornerRefinementStats
+{
+	size_t Tags = 0;
+	double Seconds = 0; //summed over the tags, the refinement runs them in parallel
+	double MaxTagSeconds = 0; //slowest tag
+};
+
+CornerRefinementStats GetCornerRefinementStats();
+
+//With a reduction factor, corners are refined on the full resolution frame, all tags in parallel (see GetCornerRefinementStats)
+//When the camera only decoded a reduced luma, they are refined on that luma instead, which is less accurate
 int DetectAruco(CameraImageData InData, CameraFeatureData *OutData);
 
-int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, cv::Size Segments);
+//A region of the frame for segmented detection, and the factor it is shrunk by before detection
+struct ArucoTile
+{
+	cv::Rect Region;
+	int Decimation = 1;
+};
+
+//Tiles laid out from the pose of the camera over the table, where tags from MinTagSize to MaxTagSize meters can be
+//The frame is cut in a Segments grid : cells that don't see the table are skipped, cells where the smallest tag looks large are decimated,
+//and each cell overlaps its neighbours by the apparent size of the largest tag. Neighbouring cells of a row with the same decimation are merged,
+//as long as that leaves at least as many tiles as detection threads
+//The layout is cached per camera name and only recomputed when the pose, lens or sizes change
+std::vector<ArucoTile> GetGeometricArucoTiles(const std::string &CameraName, cv::Size framesize, cv::Affine3d CameraTransform, 
+	cv::InputArray CameraMatrix, cv::InputArray distCoeffs, double MinTagSize, double MaxTagSize, cv::Size Segments);
+
+//Detection in overlapping segments of the frame
+//With SharedThreshold, the frame is thresholded once for all segments instead of once per segment (see ArucoSharedThreshold.hpp)
+int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, cv::Size Segments, bool SharedThreshold = false);
+
+//Detection in the given tiles. With SharedThreshold, tiles are detected at full resolution whatever their decimation
+int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, const std::vector<ArucoTile> &Tiles, bool SharedThreshold = false);
+
+//Segmented detection that only looks where the tags of the previous frames are expected to be, from their last position and speed in the image
+//A full segmented scan runs every FullScanInterval frames, when nothing is tracked, or on the frame after a tracked tag was lost
+//Tracking state is kept per camera name. Full scans use FullScanTiles if there are any, the Segments grid otherwise
+int DetectArucoTracked(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, cv::Size Segments, int FullScanInterval, bool SharedThreshold = false,
+	const std::vector<ArucoTile> &FullScanTiles = {});
 
-int DetectArucoPOI(CameraImageData InData, CameraFeatureData *OutData, const std::vector<std::vector<cv::Point3d>> &POIs);
\ No newline at end of file
+int DetectArucoPOI(CameraImageData InData, CameraFeatureData *OutData, const std::vector<std::vector<cv::Point3d>> &POIs, bool SharedThreshold = false);
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect/aruco_detector.hpp>
+
+#include <ArucoPipeline/ArucoTypes.hpp>
+
+//Aruco detection split in two stages, so that segmented detection doesn't threshold the overlap between tiles several times :
+//the adaptive thresholds are computed once per frame over the union of the tiles, then each tile extracts its contours and decodes its candidates from them
+//Follows the steps and parameters of cv::aruco::ArucoDetector. Corners are refined with cornerSubPix when refinement is enabled
+
+//Gray frame and its adaptive thresholds, one per threshold window size (see DetectorParameters::adaptiveThreshWinSize*)
+//Thresholds are only valid inside the regions they were computed for
+struct ArucoThresholdedFrame
+{
+	cv::Mat Gray;
+	std::vector<cv::Mat> Thresholds;
+};
+
+//Threshold Gray inside Regions, in parallel bands of rows
+//The box means of all window sizes come from a single integral image per band, and each pixel is thresholded once per window size
+//Pixels where Mask is 0 are left unset, so no contour is found there. An empty Mask keeps every pixel
+void ThresholdForAruco(const cv::Mat &Gray, const std::vector<cv::Rect> &Regions, const cv::aruco::DetectorParameters &Params,
+	ArucoThresholdedFrame &Frame, const cv::Mat &Mask = cv::Mat());
+
+//Find the markers inside Region of a thresholded frame. Corners are in frame coordinates
+void DetectArucoInRegion(const ArucoThresholdedFrame &Frame, cv::Rect Region, const cv::aruco::Dictionary &Dictionary,
+	const cv::aruco::DetectorParameters &Params, std::vector<ArucoCornerArray> &Corners, std::vector<int> &IDs);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+//Pixels of a camera's frame that see the table, so that detectors can skip the background
+struct BoardMask
+{
+	cv::Mat Mask; //CV_8UC1 at frame size, 255 where the table or what stands on it can be seen
+	cv::Rect Bounds; //bounding box of the non zero pixels of Mask
+
+	bool empty() const
+	{
+		return Mask.empty();
+	}
+};
+
+//Mask of the table as seen from CameraTransform : the outline of the table is projected at the table top and at the top of the robots
+//Cached per camera name and only recomputed when the pose or the lens changes
+//Empty if part of the table is behind the camera, then everything should be looked at
+BoardMask GetBoardMask(const std::string &CameraName, cv::Size framesize, cv::Affine3d CameraTransform, 
+	cv::InputArray CameraMatrix, cv::InputArray distCoeffs);
+
+//Region of the frame that is worth looking at, the whole frame if the mask is empty
+cv::Rect GetBoardBounds(const BoardMask &Mask, cv::Size framesize);
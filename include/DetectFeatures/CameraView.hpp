@@ -0,0 +1,24 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+//Frame size, pose and lens that a per camera layout (board mask, geometric tiles, POI rects) was computed for
+//All those caches use it as their key, so that they are recomputed on the same changes
+struct CameraView
+{
+	cv::Size FrameSize;
+	cv::Affine3d CameraTransform;
+	cv::Mat CameraMatrix, DistCoeffs;
+	bool Valid = false;
+
+	//The pose is filtered, moves under that don't change what the camera sees
+	static constexpr double MaxTranslation = 0.005; //meters
+	static constexpr double MaxRotation = 0.001; //radians
+
+	//Same frame size and lens, and a pose within the tolerances above
+	bool Matches(cv::Size framesize, const cv::Affine3d &InCameraTransform, const cv::Mat &InCameraMatrix, const cv::Mat &InDistCoeffs) const;
+
+	//Remember that view, the lens is copied
+	void Set(cv::Size framesize, const cv::Affine3d &InCameraTransform, const cv::Mat &InCameraMatrix, const cv::Mat &InDistCoeffs);
+};
@@ -6,6 +6,12 @@
 #include <opencv2/dnn.hpp>
 #include <opencv2/core.hpp>
 #include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
 #include <filesystem>
 
 class YoloDetect
@@ -21,14 +27,56 @@ private:
 			:BoundingBox(InBoundingBox), Confidence(InConfidence), Classes(InClasses)
 		{}
 	};
+	//Detections of the last frame each camera was run on, reused while nothing changes in the window (see FrameChanges)
+	struct CachedDetections
+	{
+		cv::Rect Window;
+		int FrameIndex = 0;
+		std::vector<YoloDetection> Detections;
+	};
+	//Run the network again after that many frames even if nothing changed
+	static constexpr int MaxReuseFrames = 30;
+	std::map<std::string, CachedDetections> LastDetections;
+
+	//Asynchronous lane : the worker runs the newest frame submitted by each camera, all cameras in one batch
+	struct AsyncJob
+	{
+		CameraImageData Image;
+		cv::Mat ROIMask;
+		cv::Rect ROIBounds;
+	};
+	struct AsyncResult
+	{
+		std::vector<YoloDetection> Detections;
+		std::chrono::steady_clock::time_point GrabTime;
+	};
+	//Results older than that compared to the frame being processed are not handed out anymore
+	static constexpr std::chrono::milliseconds MaxAsyncResultAge{1000};
+	std::map<std::string, AsyncJob> PendingJobs;
+	std::map<std::string, AsyncResult> AsyncResults;
+	bool AsyncStopping = false;
+	std::mutex AsyncMutex;
+	std::condition_variable JobAvailable;
+	std::unique_ptr<std::thread> AsyncWorker;
+	void AsyncWorkerEntryPoint();
+
+	//Held during inference, the network and the caches are shared by Detect and the worker
+	std::mutex NetworkMutex;
+
 	std::string ModelName;
 	std::vector<std::string> ClassNames;
 	cv::dnn::Net network;
+	std::string ModelFile, BackendName;
+	bool PixelCoordinates = false; //boxes are in pixels of the network input instead of relative to it
 	std::filesystem::path GetNetworkPath(std::string extension = "") const;
 	void loadNames();
+	//Loads <model>-int8.onnx or <model>.onnx when present, <model>.cfg/.weights otherwise
 	void loadNet();
-	void Preprocess(const cv::UMat& frame, cv::Size inpSize, float scale, const cv::Scalar& mean, bool swapRB);
-	std::vector<Detection> Postprocess(const std::vector<cv::Mat> &outputBlobs, const std::vector<std::string> &layerNames, cv::Rect window);
+	//Pick the fastest CPU backend and target available, following the yolo config
+	void selectBackend();
+	void Preprocess(const std::vector<cv::UMat>& frames, cv::Size inpSize, float scale, const cv::Scalar& mean, bool swapRB);
+	//Detections of image BatchIndex out of the BatchSize images that were fed to the network
+	std::vector<Detection> Postprocess(const std::vector<cv::Mat> &outputBlobs, const std::vector<std::string> &layerNames, cv::Rect window, int BatchIndex = 0, int BatchSize = 1);
 public:
 	YoloDetect(std::string inModelName = "cdfr", int inNumclasses = 4);
 	virtual ~YoloDetect();
@@ -37,8 +85,24 @@ public:
 
 	int GetNumClasses() const;
 
+	//Backend, target and model file in use, ex "OpenVINO CPU (cdfr-int8.onnx)"
+	std::string GetBackendDescription() const;
+
+	//Detections whose center is outside OutData->ROIMask are dropped, and only the bounds of the mask are fed to the network
+	//When the frame carries its changes, the last detections of the camera are reused if nothing changed in the window
+	//Blocks while the worker is running the network
 	int Detect(CameraImageData InData, CameraFeatureData *OutData);
 
+	//Same as Detect for the frames of several cameras, with a single inference over a batch of all the frames that need it
+	//Returns the total number of detections
+	int DetectBatch(const std::vector<CameraImageData> &InData, const std::vector<CameraFeatureData*> &OutData);
+
+	//Submit the frame to the worker thread, replacing the frame of that camera that wasn't started yet, and never wait for inference
+	//OutData gets the newest detections finished for that camera, they can come from an older frame (see CameraFeatureData::YoloGrabTime)
+	//The worker is started on the first call
+	int DetectAsync(const CameraImageData &InData, CameraFeatureData *OutData);
+
+	//Objects are tagged with the grab time of the frame the detections come from
 	std::vector<ObjectData> Project(const CameraImageData &ImageData, const CameraFeatureData& FeatureData);
 };
 
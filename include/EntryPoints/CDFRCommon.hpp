@@ -14,6 +14,7 @@
 #include <DetectFeatures/ArucoDetect.hpp>
 #include <DetectFeatures/YoloDetect.hpp>
 #include <DetectFeatures/ColorDetect.hpp>
+#include <DetectFeatures/BoardMask.hpp>
 
 #include <Misc/FrameCounter.hpp>
 #include <Misc/ManualProfiler.hpp>
@@ -34,10 +35,19 @@ namespace CDFRCommon
 
 		bool ArucoDetection = true;
 		bool SegmentedDetection = true;
+		bool TrackedDetection = false; //Segmented detection only looks around the tags seen in the previous frames, with a full scan every FullScanInterval frames. Opt-in : a new tag can go unseen for up to FullScanInterval-1 frames
+		int FullScanInterval = 10;
+		bool FullResolutionRefinement = true; //Whole frame detection has the camera decode the full resolution luma to refine the corners on. Off, only a reduced luma is decoded : faster, but corners are less accurate
+		bool SharedThreshold = false; //Segmented and POI detection threshold the frame once for all segments, then decode each segment from it. The fast 4x4 decode (lookup table) is only used with it
+		bool BoardMasking = false; //Once the camera is located, all detectors skip what's outside the table. Opt-in : nothing is detected off the table, even if the camera pose is off
+		bool GeometricTiles = false; //Once the camera is located, segmented detection only looks at the table, with tiles decimated where the tags look large. Opt-in : tags off the table or smaller than expected can be missed
+		bool ChangeGating = false; //Cameras track which parts of the frame changed, detectors reuse their previous results where nothing did
 		bool POIDetection = false;
 		bool YoloDetection = false;
+		bool AsyncYolo = false; //YOLO runs on its own thread at its own rate, frames get the newest detections available instead of waiting for inference. Opt-in : detections can lag the frame by an inference or more
 		bool Denoising = false;
 		bool DistortedDetection = true;
+		bool SparseUndistortion = true; //When detecting on undistorted frames, only remap the regions the detectors look at
 		bool SolveCameraLocation = true;
 
 		Settings(bool External)
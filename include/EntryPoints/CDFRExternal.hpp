@@ -1,6 +1,8 @@
 #pragma once
 
 #include <thread>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <array>
 #include <memory>
@@ -33,8 +35,13 @@ protected:
 	FrameCounter DetectionFrameCounter;
 private:
 	std::filesystem::path RecordRootPath;
+	//Created when the first frame is recorded
+	std::unique_ptr<class FrameRecorder> Recorder;
 
 	std::unique_ptr<class YoloDetect> YoloDetector;
+	//Copy of the detector's description, set once it's loaded : the detector is created on the runner thread while clients may query it
+	std::string YoloBackendDescription = "Not loaded";
+	mutable std::mutex YoloBackendMutex;
 
 	//Camera manager
 	std::unique_ptr<class CameraManager> CameraMan;
@@ -88,6 +95,9 @@ public:
 
 	CDFRTeam GetTeam();
 
+	//Backend and model yolo runs on, see YoloDetect::GetBackendDescription
+	std::string GetYoloBackend() const;
+
 	virtual void ThreadEntryPoint() override;
 
 	int GetReadBufferIndex() const;
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+//Lets a consumer sleep until one of several mailboxes gets a value
+//Count goes up on every publish, so a consumer reads it before checking its mailboxes and can't miss a publish that happens in between
+class MailboxSignal
+{
+private:
+	mutable std::mutex Mutex;
+	std::condition_variable Published;
+	uint64_t Count = 0;
+
+public:
+	void Notify()
+	{
+		{
+			std::lock_guard lock(Mutex);
+			Count++;
+		}
+		Published.notify_all();
+	}
+
+	uint64_t GetCount() const
+	{
+		std::lock_guard lock(Mutex);
+		return Count;
+	}
+
+	//Wait until something is published after LastCount was read, returns false on timeout
+	bool WaitFor(uint64_t LastCount, std::chrono::steady_clock::duration Timeout)
+	{
+		std::unique_lock lock(Mutex);
+		return Published.wait_for(lock, Timeout, [this, LastCount]{return Count != LastCount;});
+	}
+};
+
+//Lock-free single producer / single consumer mailbox that only holds the latest value.
+//It's a triple buffer : one slot belongs to the producer, one to the consumer, and the last one is exchanged between them.
+//The producer never waits for the consumer : a value that has not been fetched in time is overwritten by the next one.
+template<class T>
+class FrameMailbox
+{
+private:
+	static constexpr uint8_t IndexMask = 0x3;
+	static constexpr uint8_t NewBit = 0x4;
+
+	std::array<T, 3> Slots;
+	//Index of the exchanged slot, NewBit is set when it holds a value that the consumer has not fetched yet
+	std::atomic<uint8_t> Middle;
+	uint8_t WriteIndex; //Only touched by the producer
+	uint8_t ReadIndex; //Only touched by the consumer
+	MailboxSignal* Signal = nullptr;
+
+public:
+	FrameMailbox()
+		:Middle(1), WriteIndex(0), ReadIndex(2)
+	{}
+
+	//Notified after every Publish. Set before the producer starts
+	void SetSignal(MailboxSignal* InSignal)
+	{
+		Signal = InSignal;
+	}
+
+	//Producer : slot to fill before calling Publish
+	T& GetWriteSlot()
+	{
+		return Slots[WriteIndex];
+	}
+
+	//Producer : make the write slot the latest value, and get a new slot to write to
+	void Publish()
+	{
+		uint8_t old = Middle.exchange(WriteIndex | NewBit, std::memory_order_acq_rel);
+		WriteIndex = old & IndexMask;
+		if (Signal)
+		{
+			Signal->Notify();
+		}
+	}
+
+	//Consumer : true if a value was published since the last Fetch
+	bool HasNew() const
+	{
+		return Middle.load(std::memory_order_acquire) & NewBit;
+	}
+
+	//Consumer : take the latest published value, returns false if there was nothing new
+	bool Fetch()
+	{
+		if (!HasNew())
+		{
+			return false;
+		}
+		uint8_t old = Middle.exchange(ReadIndex, std::memory_order_acq_rel);
+		ReadIndex = old & IndexMask;
+		return true;
+	}
+
+	//Consumer : last fetched value
+	T& GetReadSlot()
+	{
+		return Slots[ReadIndex];
+	}
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+//Pool of image buffers, so that frames don't need a new allocation every time
+//Buffers are reference counted by OpenCV : a buffer is free again once the pool holds the only reference to it,
+//so frames can be handed down the pipeline (mailbox, triple buffers...) without giving them back explicitly
+//Thread safe
+class FramePool
+{
+public:
+	struct Stats
+	{
+		uint64_t Allocations = 0; //buffers that had to be allocated
+		uint64_t Reuses = 0; //buffers that were taken from the pool
+		size_t Buffers = 0; //buffers held by the pool
+	};
+
+private:
+	std::vector<cv::UMat> Buffers;
+	size_t MaxBuffersPerFormat;
+	mutable std::mutex Mutex;
+	std::atomic<uint64_t> Allocations, Reuses;
+
+	static bool IsFree(const cv::UMat &Buffer);
+
+public:
+	//MaxBuffersPerFormat should be the number of frames of a format that can be alive at the same time in the pipeline
+	FramePool(size_t InMaxBuffersPerFormat)
+		:MaxBuffersPerFormat(InMaxBuffersPerFormat), Allocations(0), Reuses(0)
+	{}
+
+	//Get a buffer of this size and type, its content is undefined
+	//If all the buffers of this format are in use, a new one is allocated, and kept if there's room for it
+	cv::UMat Get(cv::Size Size, int Type);
+
+	//Drop the free buffers
+	void Clear();
+
+	Stats GetStats() const;
+};
@@ -4,6 +4,7 @@
 #include <opencv2/objdetect/aruco_detector.hpp>
 #include <opencv2/core/affine.hpp>
 #include <filesystem>
+#include <chrono>
 
 //Defines all global config parameters, and also reads the config file.
 
@@ -18,6 +19,56 @@ struct CaptureConfig
 	int CaptureFramerate;
 	int FramerateDivider;
 	std::string filter; //filter to block or allow certain cameras. If camera name contains the filter string, it's allowed. If the filter string starts with a !, the filter is inverted
+	int BufferCount; //number of driver buffers in the mmap ring when using native V4L2 capture
+	int FrameWaitMs; //when no threaded camera has a new frame, how long the detection waits for one before running the tick anyway
+};
+
+//What the recorder does when its queue is full
+enum class RecordDropPolicy
+{
+	DropNewest = 0, //the frame being recorded is dropped
+	DropOldest = 1, //the oldest frame in the queue is dropped to make room
+	Block = 2 //the detection waits for room in the queue, nothing is dropped
+};
+
+struct RecordingConfig
+{
+	int QueueSize; //maximum number of frames waiting to be written
+	int EncoderThreads; //number of threads encoding and writing frames
+	int DropPolicy; //See RecordDropPolicy
+	bool Container; //record all cameras to a single recording file (see Cameras/RecordingFile.hpp) instead of one jpeg per frame
+};
+
+//What runs the yolo network (see YoloDetect)
+enum class YoloBackend
+{
+	Auto = 0, //OpenVINO when OpenCV was built with it, otherwise OpenCV's own
+	OpenCV = 1,
+	OpenVINO = 2
+};
+
+struct YoloConfig
+{
+	int Backend; //See YoloBackend
+	bool PreferQuantized; //load the INT8 ONNX model (<model>-int8.onnx) when it exists
+	bool FP16; //run in half precision when the backend has a CPU FP16 target, OpenVINO otherwise keeps its own precision
+	int MaxBatchSize; //frames per inference, 1 for models exported with a fixed batch size
+};
+
+//How simulated cameras are paced (see CameraManagerSimulation)
+enum class SimulationClock
+{
+	Loop = 0, //the scenario restarts forever, frames come as fast as they are decoded and are timestamped from the file
+	Benchmark = 1, //the scenario is played once as fast as possible, then a summary is printed and the program exits
+	RealTime = 2 //the scenario is played once at the framerate of the videos, then a summary is printed and the program exits
+};
+
+//Whether simulated cameras play videos from pre-decoded raw frames (see Cameras/RawFrameCache.hpp)
+enum class RawFrameCacheMode
+{
+	Off = 0, //videos are decoded while playing
+	Gray = 1, //frames are pre-decoded to gray, colour is rebuilt from it when needed
+	Color = 2 //frames are pre-decoded to BGR
 };
 
 extern bool RecordVideo;
@@ -28,6 +79,16 @@ std::string GetScenario();
 
 bool DoScreenCapture();
 
+SimulationClock GetSimulationClock();
+
+//Overrides the config, used by the command line
+void SetSimulationClock(SimulationClock Clock);
+
+RawFrameCacheMode GetRawFrameCacheMode();
+
+//Time of the first simulated frame when the scenario is played once, shared by all simulated cameras so that their frames line up
+std::chrono::steady_clock::time_point GetSimulationEpoch();
+
 const cv::aruco::ArucoDetector& GetArucoDetector();
 
 cv::Size GetFrameSize();
@@ -41,6 +102,10 @@ CameraStartType GetCaptureMethod();
 //list of downscales to be done to the aruco detections
 float GetReductionFactor();
 
+const RecordingConfig& GetRecordingConfig();
+
+const YoloConfig& GetYoloConfig();
+
 struct KeepAliveSettings
 {
 	double poke_delay;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+
+//Running estimate of a latency and of its jitter, using exponential moving averages
+//Used to know how old a frame is when it reaches the detection
+class LatencyEstimator
+{
+	typedef std::chrono::duration<double> latency;
+private:
+	double Mean = 0; //seconds
+	double Deviation = 0; //mean absolute deviation, seconds
+	bool HasSample = false;
+	double Smoothing;
+
+public:
+	LatencyEstimator(double InSmoothing = 0.05)
+		:Smoothing(InSmoothing)
+	{}
+
+	void AddSample(latency Sample)
+	{
+		double value = Sample.count();
+		if (!HasSample)
+		{
+			Mean = value;
+			Deviation = 0;
+			HasSample = true;
+			return;
+		}
+		Deviation += (std::abs(value - Mean) - Deviation) * Smoothing;
+		Mean += (value - Mean) * Smoothing;
+	}
+
+	bool IsValid() const
+	{
+		return HasSample;
+	}
+
+	//Estimated latency, in seconds
+	double GetMean() const
+	{
+		return Mean;
+	}
+
+	//Estimated jitter of the latency, in seconds
+	double GetDeviation() const
+	{
+		return Deviation;
+	}
+};
@@ -19,6 +19,7 @@ private:
 	std::string ProfilerName;
 	proftime lastswitchtick;
 	proftime lastprinttick;
+	bool active = true; //runtime switch, for when profiling is only wanted in some runs
 public:
 	ManualProfiler(std::string InProfilerName = "")
 		:currsection(""),
@@ -27,9 +28,14 @@ public:
 		lastprinttick = profclock::now();
 	}
 
+	void SetActive(bool value)
+	{
+		active = value;
+	}
+
 	void EnterSection(std::string name)
 	{
-		if (!enabled)
+		if (!enabled || !active)
 		{
 			return;
 		}
@@ -47,7 +53,7 @@ public:
 	template<bool otheren>
 	void operator+=(ManualProfiler<otheren>& other)
 	{
-		if (!enabled || !otheren)
+		if (!enabled || !otheren || !active)
 		{
 			return;
 		}
@@ -58,9 +64,10 @@ public:
 		}
 	}
 
-	void PrintProfile()
+	//If NumCycles is given, also prints the average time spent in each section per cycle
+	void PrintProfile(int NumCycles = 0)
 	{
-		if (!enabled)
+		if (!enabled || !active)
 		{
 			return;
 		}
@@ -75,14 +82,19 @@ public:
 		{
 			const std::string &name = it->first;
 			profdelta& timing = it->second;
-			std::cout << "\tSection \"" << name << "\" took " << timing.count() << "s, " << timing.count()/total.count()*100.0 << "%" << std::endl;
+			std::cout << "\tSection \"" << name << "\" took " << timing.count() << "s, " << timing.count()/total.count()*100.0 << "%";
+			if (NumCycles > 0)
+			{
+				std::cout << ", " << timing.count()/NumCycles*1000.0 << "ms per cycle";
+			}
+			std::cout << std::endl;
 		}
 		lastprinttick = profclock::now();
 	}
 
 	bool ShouldPrint()
 	{
-		if (!enabled)
+		if (!enabled || !active)
 		{
 			return false;
 		}
@@ -48,6 +48,9 @@ cv::Matx31d GetAxis(cv::Matx33d rotation, int i);
 //Get the rotation around Z axis
 double GetRotZ(cv::Matx33d rotation);
 
+//True if B is within MaxTranslation (meters) and MaxRotation (radians) of A
+bool IsPoseClose(cv::Affine3d A, cv::Affine3d B, double MaxTranslation, double MaxRotation);
+
 cv::Vec3d LinePlaneIntersection(cv::Vec3d LineOrigin, cv::Vec3d LineDirection, cv::Vec3d PlaneOrigin, cv::Vec3d PlaneNormal);
 
 cv::Vec3d ProjectPointOnLine(cv::Vec3d Point, cv::Vec3d LineOrig, cv::Vec3d LineDir);
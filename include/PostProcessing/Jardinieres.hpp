@@ -18,10 +18,18 @@ class PostProcessJardinieres : public PostProcess
 		ObjectData::TimePoint LastContactStart;
 		ObjectData::TimePoint LastContactEnd;
 		ObjectData::Clock::duration TimeSpentContacting;
+		//Plant pixels counted on LastFrame in LastRegion of the image, reused while nothing changes there (see FrameChanges)
+		cv::Rect LastRegion;
+		int LastFrame = 0;
+		int NumWhitePixels = 0;
 	};
+	//Count the plants again after that many frames even if nothing changed
+	static constexpr int MaxReuseFrames = 30;
 	std::array<StockStatus, 6> Stocks;
 public:
 	PostProcessJardinieres(CDFRExternal* InOwner);
 
+	virtual bool NeedsColorImage(size_t NumCameras) const override;
+
 	virtual void Process(std::vector<CameraImageData> &ImageData, std::vector<CameraFeatureData> &FeatureData, std::vector<ObjectData> &Objects) override;
 };
@@ -18,6 +18,9 @@ public:
 	virtual ~PostProcess();
 
 	std::vector<ObjectData> GetEnemyRobots(std::vector<ObjectData> &Objects) const;
+
+	//Does Process read the colour image ? If no one needs it, cameras only decode the luma for aruco
+	virtual bool NeedsColorImage(size_t NumCameras) const;
 	
 	virtual void Process(std::vector<CameraImageData> &ImageData, std::vector<CameraFeatureData> &FeatureData, std::vector<ObjectData> &Objects);
 };
\ No newline at end of file
@@ -15,6 +15,7 @@ class PostProcessYoloDeflicker : public PostProcess
 		{
 			Associated = false;
 			Lifetime = obj.LastSeen;
+			LastSeen = ObjectData::TimePoint();
 			*this += obj;
 		}
 
@@ -45,10 +46,14 @@ class PostProcessYoloDeflicker : public PostProcess
 			assert(!Associated);
 			cv::Vec3d mean = (other.location.translation() + location.translation())/2;
 			location.translation(mean);
-			int confidence = other.metadata.at("confidence");
-			Lifetime += std::chrono::milliseconds(confidence*10);//if 100% confident, add 1s lifetime
-			Lifetime = std::max(Lifetime, ObjectData::Clock::now() + std::chrono::seconds(3)); //max 3s lifetime
-			LastSeen = other.LastSeen;
+			//asynchronous yolo hands out the same detections until it finishes the next frame, they only extend the lifetime once
+			if (other.LastSeen > LastSeen)
+			{
+				int confidence = other.metadata.at("confidence");
+				Lifetime += std::chrono::milliseconds(confidence*10);//if 100% confident, add 1s lifetime
+				Lifetime = std::max(Lifetime, ObjectData::Now() + std::chrono::seconds(3)); //max 3s lifetime
+				LastSeen = other.LastSeen;
+			}
 			metadata = other.metadata;
 			type = other.type;
 		}
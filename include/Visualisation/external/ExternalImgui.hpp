@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <Visualisation/ImguiWindow.hpp>
 #include <Visualisation/OpenGLTask.hpp>
 
@@ -12,7 +13,8 @@ private:
 	bool closed = false;
 	bool ShowAruco = true, ShowYolo = true;
 	bool FocusPeeking = false;
-	std::vector<cv::UMatData*> LastMatrices;
+	//Grab time of the frame in each texture, frame buffers are pooled so their address doesn't tell if a frame is new
+	std::vector<std::chrono::steady_clock::time_point> LastGrabTimes;
 public:
 
 	ExternalImgui(std::string InWindowName = "ImGui", CDFRExternal *InParent = nullptr);
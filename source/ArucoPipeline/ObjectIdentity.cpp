@@ -3,9 +3,28 @@
 #include <Visualisation/BoardGL.hpp>
 #include <cassert>
 #include <map>
+#include <atomic>
 #include <iostream>
 using namespace std;
 
+//ticks of ObjectData::Clock, 0 when not simulated
+static atomic<ObjectData::Clock::rep> SimulatedNow(0);
+
+ObjectData::TimePoint ObjectData::Now()
+{
+	Clock::rep simulated = SimulatedNow;
+	if (simulated == 0)
+	{
+		return Clock::now();
+	}
+	return TimePoint(Clock::duration(simulated));
+}
+
+void ObjectData::SetSimulatedNow(TimePoint Time)
+{
+	SimulatedNow = Time.time_since_epoch().count();
+}
+
 CDFRTeam GetOtherTeam(CDFRTeam InTeam)
 {
 	switch (InTeam)
@@ -65,13 +84,13 @@ vector<GLObject> ObjectData::ToGLObjects(const vector<ObjectData>& data, Clock::
 {
 	vector<GLObject> outobj;
 	outobj.reserve(data.size());
-	TimePoint OldCutoff = Clock::now() - maxAge;
+	TimePoint OldCutoff = Now() - maxAge;
 	for (size_t i = 0; i < data.size(); i++)
 	{
 		auto &object = data[i];
 		if (object.LastSeen < OldCutoff)
 		{
-			//cout << "Filtering " << object.name << " because it's " << chrono::duration<double>(Clock::now() - object.LastSeen).count() << "s old" << endl;
+			//cout << "Filtering " << object.name << " because it's " << chrono::duration<double>(Now() - object.LastSeen).count() << "s old" << endl;
 			continue;
 		}
 		auto obj = object.ToGLObject();
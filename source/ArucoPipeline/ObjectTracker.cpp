@@ -204,6 +204,22 @@ double ObjectTracker::GetArucoSize(int number)
 	return ArucoSizes[number];
 }
 
+bool ObjectTracker::GetArucoSizeRange(double &MinSize, double &MaxSize) const
+{
+	bool found = false;
+	for (size_t i = 0; i < ArucoMap.size(); i++)
+	{
+		if (ArucoMap[i] == -1)
+		{
+			continue;
+		}
+		MinSize = found ? min(MinSize, ArucoSizes[i]) : ArucoSizes[i];
+		MaxSize = found ? max(MaxSize, ArucoSizes[i]) : ArucoSizes[i];
+		found = true;
+	}
+	return found;
+}
+
 vector<vector<Point3d>> ObjectTracker::GetPointsOfInterest() const
 {
 	vector<vector<Point3d>> poi;
@@ -62,7 +62,28 @@ bool StaticObject::ShouldBeDisplayed(TimePoint Tick) const
 vector<ObjectData> StaticObject::ToObjectData() const
 {
 	ObjectData packet(Relative ? ObjectType::ReferenceRelative : ObjectType::ReferenceAbsolute,
-		Name, Location, Relative ? LastSeenTick : Clock::now());
+		Name, Location, Relative ? LastSeenTick : ObjectData::Now());
 	packet.Childs = GetMarkersAndChilds();
 	return {packet};
-}
\ No newline at end of file
+}
+Rect2d StaticObject::GetBoardArea()
+{
+	return Rect2d(-1.5, -1.0, 3.0, 2.0);
+}
+
+const vector<double>& StaticObject::GetTableHeights()
+{
+	static const vector<double> Heights = {0.0, 0.5};
+	return Heights;
+}
+
+vector<Point3d> StaticObject::GetBoardOutline(double Height)
+{
+	Rect2d area = GetBoardArea();
+	return {
+		Point3d(area.x, area.y, Height),
+		Point3d(area.x + area.width, area.y, Height),
+		Point3d(area.x + area.width, area.y + area.height, Height),
+		Point3d(area.x, area.y + area.height, Height)
+	};
+}
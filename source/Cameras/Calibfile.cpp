@@ -117,6 +117,7 @@ bool readCameraParameters(std::filesystem::path path, CameraSettings &Settings)
 		//cout << "Calibration file resolution = " << CalibRes << endl;
 		//cout << "Reading at resolution " <<Resolution << endl;
 		//cout << scalingMatrix << " * " << calibmatrix << " = " << camMatrix << endl;
+		Settings.CalibrationFile = path;
 		return (Settings.Lenses[0].CameraMatrix.size() == Size(3,3));
 	}
 	else if (path.extension() == ".json")
@@ -124,28 +125,12 @@ bool readCameraParameters(std::filesystem::path path, CameraSettings &Settings)
 		nlohmann::json object;
 		std::ifstream file(path);
 		file >> object;
-		cv::Size current_resolution = JsonToSize<int>(object.at("Current Resolution"));
-		for (auto &&calibration : object.at("Calibrations"))
+		if (!JsonToCameraParameters(object, Settings))
 		{
-			cv::Size stored_resolution = JsonToSize<int>(calibration.at("Resolution"));
-			if (current_resolution != stored_resolution)
-			{
-				continue;
-			}
-			Settings.Lenses.clear();
-			for (auto &&lens_json : calibration.at("Lenses"))
-			{
-				LensSettings lens_struct;
-				lens_struct.CameraMatrix = JsonToMatrix<double>(lens_json.at("Camera Matrix"));
-				lens_struct.distanceCoeffs = JsonToMatrix<double>(lens_json.at("Distortion Coefficients"));
-				lens_struct.ROI = JsonToRect<int>(lens_json.at("ROI"));
-				lens_struct.LensPosition = JsonToAffine3<double>(lens_json.at("Transform"));
-				Settings.Lenses.push_back(lens_struct);
-			}
-			Settings.Resolution = current_resolution;
-			return true;
+			return false;
 		}
-		return false;
+		Settings.CalibrationFile = path;
+		return true;
 	}
 	else
 	{
@@ -171,6 +156,15 @@ void writeCameraParameters(std::filesystem::path path, const CameraSettings &Set
 	fs.write("camera_matrix", camMatrix);
 	fs.write("distortion_coefficients", distCoeffs);
 #else
+	nlohmann::json object = CameraParametersToJson(Settings);
+	path.replace_extension(".json");
+	ofstream file(path);
+	file << object.dump(1, '\t');
+#endif
+}
+
+nlohmann::json CameraParametersToJson(const CameraSettings &Settings)
+{
 	nlohmann::json object, calibration;
 	object["Current Resolution"] = SizeToJson<int>(Settings.Resolution);
 	calibration["Resolution"] = SizeToJson<int>(Settings.Resolution);
@@ -185,10 +179,33 @@ void writeCameraParameters(std::filesystem::path path, const CameraSettings &Set
 		lens["Transform"] = Affine3ToJson<double>(lenss.LensPosition);
 	}
 	object["Calibrations"][0] = calibration;
-	path.replace_extension(".json");
-	ofstream file(path);
-	file << object.dump(1, '\t');
-#endif
+	return object;
+}
+
+bool JsonToCameraParameters(const nlohmann::json &object, CameraSettings &Settings)
+{
+	cv::Size current_resolution = JsonToSize<int>(object.at("Current Resolution"));
+	for (auto &&calibration : object.at("Calibrations"))
+	{
+		cv::Size stored_resolution = JsonToSize<int>(calibration.at("Resolution"));
+		if (current_resolution != stored_resolution)
+		{
+			continue;
+		}
+		Settings.Lenses.clear();
+		for (auto &&lens_json : calibration.at("Lenses"))
+		{
+			LensSettings lens_struct;
+			lens_struct.CameraMatrix = JsonToMatrix<double>(lens_json.at("Camera Matrix"));
+			lens_struct.distanceCoeffs = JsonToMatrix<double>(lens_json.at("Distortion Coefficients"));
+			lens_struct.ROI = JsonToRect<int>(lens_json.at("ROI"));
+			lens_struct.LensPosition = JsonToAffine3<double>(lens_json.at("Transform"));
+			Settings.Lenses.push_back(lens_struct);
+		}
+		Settings.Resolution = current_resolution;
+		return true;
+	}
+	return false;
 }
 
 void MigrateCameraParameters()
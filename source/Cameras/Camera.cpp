@@ -8,14 +8,17 @@
 #include <opencv2/calib3d.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
 
 #include <Misc/math2d.hpp>
 #include <Misc/math3d.hpp>
 
 #include <Cameras/Calibfile.hpp>
+#include <Cameras/FrameRecorder.hpp>
 
 #include <ArucoPipeline/ObjectTracker.hpp>
 #include <Misc/GlobalConf.hpp>
+#include <Transport/thread-rename.hpp>
 
 using namespace cv;
 using namespace std;
@@ -43,6 +46,7 @@ bool Camera::SetCameraSetting(std::shared_ptr<CameraSettings> InSettings)
 		return false;
 	}
 	Settings = InSettings;
+	FrameBuffers.Clear();
 	return true;
 }
 
@@ -94,12 +98,86 @@ void Camera::UpdateFrameNumber()
 	}
 }
 
+bool Camera::CaptureFrame(CameraImageData &Frame)
+{
+	(void)Frame;
+	cerr << "ERROR : Tried to capture a frame on base class Camera !" << endl;
+	return false;
+}
+
+void Camera::CaptureThreadEntryPoint()
+{
+	SetThreadName("CameraCapture");
+	while (!CaptureThreadKilled)
+	{
+		CameraImageData &Frame = CaptureMailbox.GetWriteSlot();
+		//The previous images in this slot may still be used downstream, never decode over them
+		Frame.Image = UMat();
+		Frame.GrayImage = UMat();
+		Frame.Compressed = Mat();
+		if (!CaptureFrame(Frame))
+		{
+			if (ended)
+			{
+				//nothing left to play back
+				break;
+			}
+			cerr << "Failed to capture frame for camera " << Name << endl;
+			RegisterError();
+			this_thread::sleep_for(chrono::milliseconds(10));
+			continue;
+		}
+		RegisterNoError();
+		Frame.CameraName = Name;
+		Frame.Distorted = true;
+		Frame.Valid = true;
+		CaptureMailbox.Publish();
+	}
+}
+
+void Camera::StartCaptureThread()
+{
+	if (CaptureThread || !connected)
+	{
+		return;
+	}
+	CaptureThreadKilled = false;
+	CaptureMailbox.SetSignal(&GetNewFrameSignal());
+	CaptureThread = make_unique<thread>(&Camera::CaptureThreadEntryPoint, this);
+}
+
+void Camera::StopCaptureThread()
+{
+	if (!CaptureThread)
+	{
+		return;
+	}
+	CaptureThreadKilled = true;
+	CaptureThread->join();
+	CaptureThread.reset();
+}
+
+bool Camera::HasNewFrame() const
+{
+	return CaptureMailbox.HasNew();
+}
+
+MailboxSignal& Camera::GetNewFrameSignal()
+{
+	static MailboxSignal Signal;
+	return Signal;
+}
+
 bool Camera::Grab()
 {
 	if (!connected)
 	{
 		return false;
 	}
+	if (IsCaptureThreaded())
+	{
+		return HasNewFrame();
+	}
 	
 	UpdateFrameNumber();
 	captureTime = std::chrono::steady_clock::now();
@@ -113,6 +191,17 @@ bool Camera::Read()
 	{
 		return false;
 	}
+	if (IsCaptureThreaded())
+	{
+		if (!CaptureMailbox.Fetch())
+		{
+			return false;
+		}
+		SetLastFrame(CaptureMailbox.GetReadSlot());
+		UpdateFrameNumber();
+		SetCaptureTime(CaptureMailbox.GetReadSlot().GrabTime);
+		return true;
+	}
 	if (!grabbed)
 	{
 		UpdateFrameNumber();
@@ -122,35 +211,160 @@ bool Camera::Read()
 	return false;
 }
 
-void Camera::Undistort()
+bool Camera::DecodeToPool(const Mat &Compressed, int Flags, Size ExpectedSize, UMat &Target)
 {
-	
-	if (!HasUndistortionMaps)
+	int type = (Flags == IMREAD_COLOR) ? CV_8UC3 : CV_8UC1;
+	UMat Buffer = FrameBuffers.Get(ExpectedSize, type);
+	Mat Decoded;
+	bool InPlace;
 	{
-		//assert(Settings->IsMono());
-		Mat map1(Settings->Resolution, CV_32F), map2(Settings->Resolution, CV_32F);
-		Size cammatsz = Settings->Lenses[0].CameraMatrix.size();
-		if (cammatsz.height != 3 || cammatsz.width != 3)
-		{
-			RegisterError();
-			cerr << "Asking for undistortion but camera matrix is invalid ! Camera " << Name << endl;
-			return;
-		}
-		//cout << "Creating undistort map using Camera Matrix " << endl << setcopy.CameraMatrix << endl 
-		//<< " and Distance coeffs " << endl << setcopy.distanceCoeffs << endl;
-		for (size_t i = 0; i < Settings->Lenses.size(); i++)
+		//decode straight into the pooled buffer, imdecode only reallocates if the size is not the expected one
+		Mat BufferMat = Buffer.getMat(ACCESS_WRITE);
+		uchar* BufferData = BufferMat.data;
+		Decoded = imdecode(Compressed, Flags, &BufferMat);
+		InPlace = BufferMat.data == BufferData;
+	}
+	if (Decoded.empty())
+	{
+		return false;
+	}
+	if (InPlace)
+	{
+		Decoded.release();
+		Target = Buffer;
+		return true;
+	}
+	Target = FrameBuffers.Get(Decoded.size(), Decoded.type());
+	Decoded.copyTo(Target);
+	return true;
+}
+
+bool Camera::DecodeCompressed(const Mat &Compressed, CameraImageData &Frame)
+{
+	if (Compressed.empty())
+	{
+		return false;
+	}
+	int scale = LumaOnlyScale;
+	if (scale <= 0)
+	{
+		return DecodeToPool(Compressed, IMREAD_COLOR, Settings->Resolution, Frame.Image);
+	}
+	//reduced decodes use the DCT scaling of libjpeg(-turbo), chroma is never decoded
+	int flags;
+	switch (scale)
+	{
+	case 2:
+		flags = IMREAD_REDUCED_GRAYSCALE_2;
+		break;
+	case 4:
+		flags = IMREAD_REDUCED_GRAYSCALE_4;
+		break;
+	case 8:
+		flags = IMREAD_REDUCED_GRAYSCALE_8;
+		break;
+	default:
+		flags = IMREAD_GRAYSCALE;
+		scale = 1;
+		break;
+	}
+	Size ReducedSize((Settings->Resolution.width + scale - 1) / scale, (Settings->Resolution.height + scale - 1) / scale);
+	if (!DecodeToPool(Compressed, flags, ReducedSize, Frame.GrayImage))
+	{
+		return false;
+	}
+	Frame.GrayScaleDenominator = scale;
+	return true;
+}
+
+void Camera::SetLastFrame(const CameraImageData &Frame)
+{
+	LastFrameDistorted = Frame.Image;
+	LastFrameUndistorted = UMat();
+	LastFrameSparseUndistorted.reset();
+	LastFrameGray = Frame.GrayImage;
+	LastFrameGrayScale = Frame.GrayScaleDenominator;
+	LastFrameCompressed = Frame.Compressed;
+}
+
+void Camera::SetCaptureTime(std::chrono::steady_clock::time_point Time)
+{
+	captureTime = Time;
+	CaptureLatency.AddSample(std::chrono::steady_clock::now() - Time);
+}
+
+void Camera::SetDecodeMode(bool LumaOnly, int ScaleDenominator)
+{
+	LumaOnlyScale = LumaOnly ? max(1, ScaleDenominator) : 0;
+}
+
+bool Camera::DecodeColor()
+{
+	if (!LastFrameDistorted.empty())
+	{
+		return true;
+	}
+	if (LastFrameCompressed.empty())
+	{
+		//raw luma only sources (pre-decoded gray playback) : rebuild a colour image from it
+		if (LastFrameGray.empty() || LastFrameGrayScale != 1)
 		{
-			auto &lens = Settings->Lenses[i];
-			initUndistortRectifyMap(lens.CameraMatrix, lens.distanceCoeffs, Mat::eye(3,3, CV_64F), 
-			lens.CameraMatrix, lens.ROI.size(), CV_32FC1, map1(lens.ROI), map2(lens.ROI));
+			return false;
 		}
-		map1.copyTo(UndistMap1);
-		map2.copyTo(UndistMap2);
-		HasUndistortionMaps = true;
+		LastFrameDistorted = FrameBuffers.Get(LastFrameGray.size(), CV_8UC3);
+		cvtColor(LastFrameGray, LastFrameDistorted, COLOR_GRAY2BGR);
+		return true;
+	}
+	if (!DecodeToPool(LastFrameCompressed, IMREAD_COLOR, Settings->Resolution, LastFrameDistorted))
+	{
+		RegisterError();
+		return false;
+	}
+	return true;
+}
+
+bool Camera::PrepareUndistortionMaps()
+{
+	if (HasUndistortionMaps)
+	{
+		return true;
+	}
+	//assert(Settings->IsMono());
+	Size cammatsz = Settings->Lenses.size() > 0 ? Settings->Lenses[0].CameraMatrix.size() : Size();
+	if (cammatsz.height != 3 || cammatsz.width != 3)
+	{
+		RegisterError();
+		cerr << "Asking for undistortion but camera matrix is invalid ! Camera " << Name << endl;
+		return false;
+	}
+	UndistMaps = GetUndistortionMaps(Settings->Lenses, Settings->Resolution, Settings->CalibrationFile);
+	if (!UndistMaps)
+	{
+		RegisterError();
+		cerr << "Failed to create undistortion maps for camera " << Name << endl;
+		return false;
+	}
+	HasUndistortionMaps = true;
+	return true;
+}
+
+void Camera::Undistort()
+{
+	if (!DecodeColor())
+	{
+		return;
+	}
+	if (!PrepareUndistortionMaps())
+	{
+		return;
+	}
+	if (LastFrameUndistorted.empty())
+	{
+		LastFrameUndistorted = FrameBuffers.Get(LastFrameDistorted.size(), LastFrameDistorted.type());
 	}
 	try
 	{
-		remap(LastFrameDistorted, LastFrameUndistorted, UndistMap1, UndistMap2, INTER_LINEAR);
+		remap(LastFrameDistorted, LastFrameUndistorted, UndistMaps->Map1, UndistMaps->Map2, INTER_LINEAR);
 	}
 	catch(const std::exception& e)
 	{
@@ -159,23 +373,73 @@ void Camera::Undistort()
 	}
 }
 
+void Camera::UndistortSparse()
+{
+	if (LastFrameSparseUndistorted && LastFrameSparseUndistorted->GetFrameNumber() == FrameNumber)
+	{
+		return;
+	}
+	if (!PrepareUndistortionMaps())
+	{
+		return;
+	}
+	UMat Source;
+	if (!LastFrameGray.empty() && LastFrameGrayScale == 1)
+	{
+		Source = LastFrameGray;
+	}
+	else if (DecodeColor())
+	{
+		Source = LastFrameDistorted;
+	}
+	else
+	{
+		return;
+	}
+	LastFrameSparseUndistorted = make_shared<SparseUndistortedFrame>(Source, 
+		FrameBuffers.Get(Source.size(), Source.type()), UndistMaps, FrameNumber);
+}
+
+void Camera::UpdateFrameChanges()
+{
+	if (!LastFrameGray.empty())
+	{
+		LastFrameChanges = ChangeTracker.Update(LastFrameGray, Settings->Resolution);
+	}
+	else
+	{
+		LastFrameChanges = ChangeTracker.Update(LastFrameDistorted, Settings->Resolution);
+	}
+	LastFrameChangesNumber = FrameNumber;
+}
+
 CameraImageData Camera::GetFrame(bool Distorted) const
 {
 	//assert(Settings->IsMono() || Distorted);
 	CameraImageData frame;
 	frame.Distorted = Distorted;
 	frame.CameraName = Name;
+	frame.FrameSize = Settings->Resolution;
 	if (Distorted)
 	{
 		frame.lenses = Settings->Lenses;
 		frame.Image = LastFrameDistorted;
+		frame.GrayImage = LastFrameGray;
+		frame.GrayScaleDenominator = LastFrameGrayScale;
+		frame.Compressed = LastFrameCompressed;
+		frame.Changes = GetFrameChanges();
 	}
 	else
 	{
 		GetCameraSettingsAfterUndistortion(frame.lenses);
 		frame.Image = LastFrameUndistorted;
+		if (frame.Image.empty())
+		{
+			frame.SparseUndistorted = LastFrameSparseUndistorted;
+		}
 	}
 	frame.GrabTime = captureTime;
+	frame.Latency = CaptureLatency.GetMean();
 	frame.Valid = true;
 	return frame;
 }
@@ -186,12 +450,29 @@ vector<ObjectData> Camera::ToObjectData() const
 	return {camera};
 }
 
-void Camera::Record(filesystem::path rootPath, int RecordIdx)
+void Camera::Record(filesystem::path rootPath, int RecordIdx, FrameRecorder* Recorder)
 {
 	string folderstr = Name.substr(0, std::min<size_t>(Name.find(' '), 10));
 	char buffer[16]= {0};
 	snprintf(buffer, sizeof(buffer)-1, "%04d", RecordIdx);
-	auto writepath = rootPath/folderstr/(string(buffer) + string(".jpg"));
-	filesystem::create_directories(writepath.parent_path());
-	imwrite(writepath.string(), GetFrame(true).Image);
-}
\ No newline at end of file
+	RecordingJob Job;
+	Job.Path = rootPath/folderstr/(string(buffer) + string(".jpg"));
+	Job.Compressed = LastFrameCompressed;
+	Job.CameraName = Name.substr(0, Name.find(" @ "));
+	Job.Settings = Settings;
+	Job.GrabTime = captureTime;
+	Job.FrameNumber = FrameNumber;
+	Job.Pose = Location;
+	Job.PositionLocked = PositionLocked;
+	if (Job.Compressed.empty())
+	{
+		DecodeColor();
+		Job.Image = LastFrameDistorted;
+	}
+	if (Recorder)
+	{
+		Recorder->Enqueue(move(Job));
+		return;
+	}
+	FrameRecorder::WriteJob(Job);
+}
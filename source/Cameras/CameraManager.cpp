@@ -9,13 +9,14 @@ void CameraManager::SetIdle(bool value)
 		return;
 	}
 	Idle = value;
+	RequestScan();
 }
 
 vector<Camera*> CameraManager::Tick()
 {
 	for (size_t i = 0; i < Cameras.size(); i++)
 	{
-		if (Cameras[i]->errors >= 20 || Idle)
+		if (Cameras[i]->errors >= 20 || Cameras[i]->ended || Idle)
 		{
 			std::cerr << "Detaching camera @ " << Cameras[i]->GetName() << std::endl;
 			std::string pathtofind = dynamic_cast<const VideoCaptureCameraSettings*>(Cameras[i]->GetCameraSettings())->DeviceInfo.device_paths[0];
@@ -25,6 +26,7 @@ vector<Camera*> CameraManager::Tick()
 			usedpaths.erase(pathtofind);
 			Cameras.erase(std::next(Cameras.begin(), i));
 			i--;
+			RequestScan();
 		}
 	}
 	{
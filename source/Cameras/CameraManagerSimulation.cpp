@@ -5,6 +5,7 @@
 #include <regex>
 #include <nlohmann/json.hpp>
 #include <Cameras/Calibfile.hpp>
+#include <Cameras/RecordingFile.hpp>
 #include <Misc/path.hpp>
 #include <Misc/GlobalConf.hpp>
 #include <Transport/thread-rename.hpp>
@@ -107,11 +108,49 @@ void TurnFolderToVideo(std::filesystem::path folderPath)
 	
 }
 
+void CameraManagerSimulation::StartRecordingCameras(filesystem::path RecordingPath, const vector<unsigned int> &CameraLockToggles)
+{
+	auto Recording = RecordingReader::Open(RecordingPath);
+	if (!Recording)
+	{
+		cerr << "Could not open recording " << RecordingPath << endl;
+		return;
+	}
+	for (auto &recorded : Recording->GetCameras())
+	{
+		string pathtofind = Recording->GetPath().string() + ":" + recorded.Name;
+		VideoCaptureCameraSettings settings;
+		settings.Resolution = recorded.Settings.Resolution;
+		settings.Lenses = recorded.Settings.Lenses;
+		settings.CalibrationFile = recorded.Settings.CalibrationFile;
+		settings.StartType = CameraStartType::RECORDING;
+		settings.StartPath = Recording->GetPath().string();
+		settings.DeviceInfo.device_paths.push_back(pathtofind);
+		settings.DeviceInfo.device_description = recorded.Name;
+		settings.CameraLockToggles = CameraLockToggles;
+		auto cam = StartCamera(settings);
+		if (!cam)
+		{
+			std::cerr << "Did not open recorded camera " << recorded.Name << " @ " << RecordingPath << " : StartCamera returned null" << std::endl;
+			continue;
+		}
+		{
+			unique_lock lock(pathmutex);
+			usedpaths.emplace(pathtofind);
+		}
+		{
+			unique_lock lock(cammutex);
+			NewCameras.emplace_back(cam);
+		}
+	}
+}
+
 void CameraManagerSimulation::ThreadEntryPoint()
 {
 	SetThreadName("CameraManagerSimulation");
-	//number of times the cameras have been restarted. Limited to 1 when recording the screens
+	//number of times the cameras have been restarted. Limited to 1 when recording the screens or when the scenario is played once
 	int NumberOfInvocation = 0;
+	bool PlayOnce = GetSimulationClock() != SimulationClock::Loop;
 	while (!killed)
 	{
 		if (Idle)
@@ -139,7 +178,11 @@ void CameraManagerSimulation::ThreadEntryPoint()
 				exit(0);
 				continue;
 			}
-			
+			if (NumberOfInvocation > 0 && PlayOnce)
+			{
+				cout << "Scenario played once, no camera left" << endl;
+				break;
+			}
 		}
 		if (!filesystem::exists(ScenarioPath))
 		{
@@ -147,6 +190,14 @@ void CameraManagerSimulation::ThreadEntryPoint()
 			break;
 		}
 		
+		//a recording file can be replayed directly, without a scenario
+		if (filesystem::path(ScenarioPath).extension() == ".cyrec")
+		{
+			StartRecordingCameras(ScenarioPath, {});
+			NumberOfInvocation++;
+			continue;
+		}
+		
 		auto rootPath = filesystem::weakly_canonical(ScenarioPath).parent_path();
 		
 		ifstream scenario(ScenarioPath);
@@ -168,13 +219,20 @@ void CameraManagerSimulation::ThreadEntryPoint()
 		
 		for (auto &i : decoded.items())
 		{
-			filesystem::path calibpath, videopath;
+			filesystem::path calibpath, videopath, recordingpath;
 			vector<unsigned int> CameraLockToggles;
 			try
 			{
 				auto value = i.value();
-				calibpath = rootPath / value["calibration"];
-				videopath = rootPath / value["video"];
+				if (value.contains("recording"))
+				{
+					recordingpath = rootPath / value["recording"];
+				}
+				else
+				{
+					calibpath = rootPath / value["calibration"];
+					videopath = rootPath / value["video"];
+				}
 				if (value.contains("locks") && value["locks"].is_array())
 				{
 					for (auto &&i : value["locks"])
@@ -192,6 +250,12 @@ void CameraManagerSimulation::ThreadEntryPoint()
 				continue;
 			}
 			
+			if (!recordingpath.empty())
+			{
+				StartRecordingCameras(recordingpath, CameraLockToggles);
+				continue;
+			}
+			
 			VideoCaptureCameraSettings settings;
 			readCameraParameters(calibpath, settings);
 			settings.StartType = CameraStartType::PLAYBACK;
@@ -220,4 +284,5 @@ void CameraManagerSimulation::ThreadEntryPoint()
 		}
 		NumberOfInvocation++;
 	}
+	Finished = PlayOnce;
 }
\ No newline at end of file
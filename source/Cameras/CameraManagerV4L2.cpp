@@ -5,6 +5,11 @@
 #include <Misc/path.hpp>
 #include <Transport/thread-rename.hpp>
 
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
 using namespace std;
 
 
@@ -91,76 +96,148 @@ vector<VideoCaptureCameraSettings> CameraManagerV4L2::autoDetectCameras(CameraSt
 	return detected;
 }
 
-void CameraManagerV4L2::ThreadEntryPoint()
+void CameraManagerV4L2::ScanDevices()
 {
-	SetThreadName("CameraManagerV4L2");
-	while (!killed)
+	std::vector<v4l2::devices::DEVICE_INFO> devices;
+	v4l2::devices::list(devices);
+	std::set<std::string> knownpaths, unknownpaths;
+	{
+		shared_lock lock(pathmutex);
+		std::copy(usedpaths.begin(), usedpaths.end(), std::inserter(knownpaths, knownpaths.end()));
+		std::copy(blockedpaths.begin(), blockedpaths.end(), std::inserter(knownpaths, knownpaths.end()));
+	}
+	
+
+	for (auto &device : devices)
 	{
-		if (Idle)
+		std::string pathtofind = device.device_paths[0];
+		auto pos = std::find(knownpaths.begin(), knownpaths.end(), pathtofind);
+		if (pos != knownpaths.end()) //new camera
 		{
-			this_thread::sleep_for(chrono::milliseconds(1000));
 			continue;
 		}
-		
-		std::vector<v4l2::devices::DEVICE_INFO> devices;
-		v4l2::devices::list(devices);
-		std::set<std::string> knownpaths, unknownpaths;
+
+		VideoCaptureCameraSettings settings = DeviceToSettings(device, Start);
+		if (!settings.IsValid()) //no valid settings
 		{
-			shared_lock lock(pathmutex);
-			std::copy(usedpaths.begin(), usedpaths.end(), std::inserter(knownpaths, knownpaths.end()));
-			std::copy(blockedpaths.begin(), blockedpaths.end(), std::inserter(knownpaths, knownpaths.end()));
+			std::cerr << "Failed to open camera " << device.device_description << " @ " << pathtofind << " : Invalid settings" << std::endl;
+			unique_lock lock(pathmutex);
+			blockedpaths.emplace(pathtofind);
+			continue;
 		}
-		
 
-		for (auto &device : devices)
+		bool HasCalib = settings.IsValidCalibration();
+		if (!AllowNoCalib && !HasCalib)
 		{
-			std::string pathtofind = device.device_paths[0];
-			auto pos = std::find(knownpaths.begin(), knownpaths.end(), pathtofind);
-			if (pos != knownpaths.end()) //new camera
-			{
-				continue;
-			}
+			std::cerr << "Did not open camera " << device.device_description << " @ " << pathtofind << " : Camera has no calibration" << std::endl;
+			unique_lock lock(pathmutex);
+			blockedpaths.emplace(pathtofind);
+			continue;
+		}
+		//cout << "Camera matrix : " << settings.CameraMatrix << " / Distance coeffs : " << settings.distanceCoeffs << endl;
+		auto cam = StartCamera(settings);
+		if (!cam)
+		{
+			std::cerr << "Did not open camera " << device.device_description << " @ " << pathtofind << " : StartCamera returned null" << std::endl;
+			unique_lock lock(pathmutex);
+			blockedpaths.emplace(pathtofind);
+			continue;
+		}
 
-			VideoCaptureCameraSettings settings = DeviceToSettings(device, Start);
-			if (!settings.IsValid()) //no valid settings
+		{
 			{
-				std::cerr << "Failed to open camera " << device.device_description << " @ " << pathtofind << " : Invalid settings" << std::endl;
 				unique_lock lock(pathmutex);
-				blockedpaths.emplace(pathtofind);
-				continue;
+				usedpaths.emplace(pathtofind);
 			}
-
-			bool HasCalib = settings.IsValidCalibration();
-			if (!AllowNoCalib && !HasCalib)
 			{
-				std::cerr << "Did not open camera " << device.device_description << " @ " << pathtofind << " : Camera has no calibration" << std::endl;
-				unique_lock lock(pathmutex);
-				blockedpaths.emplace(pathtofind);
-				continue;
+				unique_lock lock(cammutex);
+				NewCameras.emplace_back(cam);
 			}
-			//cout << "Camera matrix : " << settings.CameraMatrix << " / Distance coeffs : " << settings.distanceCoeffs << endl;
-			auto cam = StartCamera(settings);
-			if (!cam)
+			
+		}
+	}
+}
+
+bool CameraManagerV4L2::ReadDeviceEvents(int InotifyFd)
+{
+	bool changed = false;
+	alignas(inotify_event) char buffer[4096];
+	while (true)
+	{
+		ssize_t length = read(InotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			break;
+		}
+		for (char* ptr = buffer; ptr < buffer + length;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+			if (event->len == 0 || strncmp(event->name, "video", 5) != 0)
 			{
-				std::cerr << "Did not open camera " << device.device_description << " @ " << pathtofind << " : StartCamera returned null" << std::endl;
-				unique_lock lock(pathmutex);
-				blockedpaths.emplace(pathtofind);
 				continue;
 			}
+			changed = true;
+			unique_lock lock(pathmutex);
+			blockedpaths.erase(string("/dev/") + event->name);
+		}
+	}
+	return changed;
+}
 
+bool CameraManagerV4L2::WaitForDeviceEvents(int InotifyFd, chrono::milliseconds Timeout)
+{
+	if (InotifyFd < 0)
+	{
+		this_thread::sleep_for(Timeout);
+		return true;
+	}
+	pollfd pfd = {InotifyFd, POLLIN, 0};
+	if (poll(&pfd, 1, Timeout.count()) <= 0)
+	{
+		return false;
+	}
+	if (!ReadDeviceEvents(InotifyFd))
+	{
+		return false;
+	}
+	//device nodes show up before udev has set their permissions, let the events of a plug settle
+	this_thread::sleep_for(chrono::milliseconds(20));
+	ReadDeviceEvents(InotifyFd);
+	return true;
+}
+
+void CameraManagerV4L2::ThreadEntryPoint()
+{
+	SetThreadName("CameraManagerV4L2");
+	//Only enumerate the devices when video devices come and go, instead of polling
+	int InotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (InotifyFd >= 0 && inotify_add_watch(InotifyFd, "/dev", IN_CREATE | IN_DELETE | IN_ATTRIB) < 0)
+	{
+		close(InotifyFd);
+		InotifyFd = -1;
+	}
+	if (InotifyFd < 0)
+	{
+		cerr << "WARNING : Failed to watch /dev for cameras, polling for them instead" << endl;
+	}
+	bool ScanNeeded = true;
+	while (!killed)
+	{
+		if (!Idle)
+		{
+			ScanNeeded |= ScanRequested.exchange(false);
+			if (ScanNeeded)
 			{
-				{
-					unique_lock lock(pathmutex);
-					usedpaths.emplace(pathtofind);
-				}
-				{
-					unique_lock lock(cammutex);
-					NewCameras.emplace_back(cam);
-				}
-				
+				ScanDevices();
+				ScanNeeded = false;
 			}
 		}
-
-		this_thread::sleep_for(std::chrono::milliseconds(1000));
+		//the timeout only bounds how long it takes to notice killed or a scan request
+		ScanNeeded |= WaitForDeviceEvents(InotifyFd, chrono::milliseconds(InotifyFd < 0 ? 1000 : 100));
+	}
+	if (InotifyFd >= 0)
+	{
+		close(InotifyFd);
 	}
 }
\ No newline at end of file
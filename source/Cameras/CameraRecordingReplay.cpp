@@ -0,0 +1,158 @@
+#include "Cameras/CameraRecordingReplay.hpp"
+
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+bool CameraRecordingReplay::StartFeed()
+{
+	if (connected)
+	{
+		return false;
+	}
+	grabbed = false;
+	VideoCaptureCameraSettings* Settingscast = dynamic_cast<VideoCaptureCameraSettings*>(Settings.get());
+	Recording = RecordingReader::Open(string(Settingscast->StartPath));
+	if (!Recording)
+	{
+		return false;
+	}
+	Recorded = nullptr;
+	for (auto &camera : Recording->GetCameras())
+	{
+		if (camera.Name == Settingscast->DeviceInfo.device_description)
+		{
+			Recorded = &camera;
+			break;
+		}
+	}
+	if (!Recorded)
+	{
+		cerr << "Camera " << Settingscast->DeviceInfo.device_description << " is not in recording " << Recording->GetPath() << endl;
+		Recording.reset();
+		return false;
+	}
+	Name = Recorded->Name + string(" @ ") + Recording->GetPath().filename().string();
+	cout << "Replaying camera " << Recorded->Name << " from " << Recording->GetPath() << " (" << Recorded->Frames.size() << " frames)" << endl;
+	Settingscast->Resolution = Recorded->Settings.Resolution;
+	Settingscast->Lenses = Recorded->Settings.Lenses;
+	Settingscast->CalibrationFile = Recorded->Settings.CalibrationFile;
+	HasUndistortionMaps = false;
+	NextFrame = 0;
+	Clock = GetSimulationClock();
+	PlaybackStart = Clock == SimulationClock::Loop ? chrono::steady_clock::now() : GetSimulationEpoch();
+	connected = true;
+	return true;
+}
+
+bool CameraRecordingReplay::CaptureFrame(CameraImageData &Frame)
+{
+	if (NextFrame >= Recorded->Frames.size())
+	{
+		if (!ended)
+		{
+			cout << "Recording ended for camera " << Name << endl;
+		}
+		ended = true;
+		return false;
+	}
+	const RecordedFrame &recorded = Recorded->Frames[NextFrame];
+	NextFrame++;
+	if (!DecodeCompressed(recorded.Jpeg, Frame))
+	{
+		return false;
+	}
+	//the mapping goes away with the recording, frames may outlive it
+	if (NeedsCompressedCopy())
+	{
+		Frame.Compressed = recorded.Jpeg.clone();
+	}
+	//keep the time between frames and between cameras as recorded
+	Frame.GrabTime = PlaybackStart + (recorded.GrabTime - Recording->GetStartTime());
+	if (Clock == SimulationClock::RealTime)
+	{
+		this_thread::sleep_until(Frame.GrabTime);
+	}
+	return true;
+}
+
+bool CameraRecordingReplay::Grab()
+{
+	if (!connected)
+	{
+		return false;
+	}
+	if (IsCaptureThreaded())
+	{
+		return Camera::Grab();
+	}
+	grabbed = true;
+	return NextFrame < Recorded->Frames.size();
+}
+
+bool CameraRecordingReplay::Read()
+{
+	if (!connected)
+	{
+		return false;
+	}
+	if (IsCaptureThreaded())
+	{
+		if (!Camera::Read())
+		{
+			return false;
+		}
+		ApplyRecordedPose(FindRecordedFrame(captureTime));
+		return true;
+	}
+	size_t FrameIndex = NextFrame;
+	CameraImageData Frame;
+	if (!CaptureFrame(Frame))
+	{
+		grabbed = false;
+		if (ended)
+		{
+			return false;
+		}
+		cerr << "Failed to decode recorded frame " << FrameIndex << " for camera " << Name << endl;
+		RegisterError();
+		return false;
+	}
+	SetLastFrame(Frame);
+	RegisterNoError();
+	grabbed = false;
+	UpdateFrameNumber();
+	captureTime = Frame.GrabTime;
+	ApplyRecordedPose(FrameIndex);
+	return true;
+}
+
+size_t CameraRecordingReplay::FindRecordedFrame(chrono::steady_clock::time_point GrabTime) const
+{
+	//frames are replayed at their recorded time offset from PlaybackStart
+	auto RecordedTime = Recording->GetStartTime() + (GrabTime - PlaybackStart);
+	auto found = lower_bound(Recorded->Frames.begin(), Recorded->Frames.end(), RecordedTime, 
+		[](const RecordedFrame &Frame, chrono::steady_clock::time_point Time){return Frame.GrabTime < Time;});
+	if (found == Recorded->Frames.end() || found->GrabTime != RecordedTime)
+	{
+		return Recorded->Frames.size();
+	}
+	return found - Recorded->Frames.begin();
+}
+
+void CameraRecordingReplay::ApplyRecordedPose(size_t FrameIndex)
+{
+	if (FrameIndex >= Recorded->Frames.size())
+	{
+		return;
+	}
+	const RecordedFrame &recorded = Recorded->Frames[FrameIndex];
+	if (recorded.PositionLocked)
+	{
+		SetLocation(recorded.Pose, captureTime);
+		SetPositionLock(true);
+	}
+}
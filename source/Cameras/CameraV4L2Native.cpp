@@ -0,0 +1,300 @@
+#include "Cameras/CameraV4L2Native.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <poll.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <thirdparty/list-devices.hpp>
+#include <Misc/GlobalConf.hpp>
+
+using namespace cv;
+using namespace std;
+
+//ioctl that retries when interrupted by a signal
+static int xioctl(int fd, unsigned long request, void* arg)
+{
+	int r;
+	do
+	{
+		r = ioctl(fd, request, arg);
+	} while (r == -1 && errno == EINTR);
+	return r;
+}
+
+//Exposure time of a buffer. Monotonic V4L2 timestamps use the same clock as steady_clock
+static chrono::steady_clock::time_point GetBufferTime(const v4l2_buffer &buf)
+{
+	if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) != V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+	{
+		return chrono::steady_clock::now();
+	}
+	auto sincestart = chrono::seconds(buf.timestamp.tv_sec) + chrono::microseconds(buf.timestamp.tv_usec);
+	return chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(sincestart));
+}
+
+CameraV4L2Native::~CameraV4L2Native()
+{
+	StopCaptureThread();
+	StopFeed();
+}
+
+void CameraV4L2Native::StopFeed()
+{
+	if (fd < 0)
+	{
+		return;
+	}
+	v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	xioctl(fd, VIDIOC_STREAMOFF, &type);
+	for (auto &buffer : Buffers)
+	{
+		munmap(buffer.start, buffer.length);
+	}
+	Buffers.clear();
+	close(fd);
+	fd = -1;
+	connected = false;
+}
+
+bool CameraV4L2Native::StartFeed()
+{
+	if (connected)
+	{
+		return false;
+	}
+	grabbed = false;
+	HasGrabbedBuffer = false;
+
+	VideoCaptureCameraSettings* Settingscast = dynamic_cast<VideoCaptureCameraSettings*>(Settings.get());
+	string pathtodevice = Settingscast->DeviceInfo.device_paths[0];
+	Name = Settingscast->DeviceInfo.device_description + string(" @ ") +  pathtodevice;
+	Settingscast->StartPath = pathtodevice;
+	Settingscast->ApiID = -1;
+
+	cout << "Opening device at \"" << pathtodevice << "\" with native V4L2 capture" << endl;
+	fd = open(pathtodevice.c_str(), O_RDWR);
+	if (fd < 0)
+	{
+		cerr << "Failed to open " << pathtodevice << " : " << strerror(errno) << endl;
+		return false;
+	}
+
+	v4l2_format fmt;
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.fmt.pix.width = Settings->Resolution.width;
+	fmt.fmt.pix.height = Settings->Resolution.height;
+	fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_MJPEG;
+	fmt.fmt.pix.field = V4L2_FIELD_ANY;
+	if (xioctl(fd, VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_MJPEG)
+	{
+		cerr << "Camera " << Name << " does not support MJPEG capture" << endl;
+		StopFeed();
+		return false;
+	}
+	Settingscast->Resolution.width = fmt.fmt.pix.width;
+	Settingscast->Resolution.height = fmt.fmt.pix.height;
+
+	v4l2_streamparm parm;
+	memset(&parm, 0, sizeof(parm));
+	parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	parm.parm.capture.timeperframe.numerator = Settings->FramerateDivider;
+	parm.parm.capture.timeperframe.denominator = Settings->Framerate;
+	if (xioctl(fd, VIDIOC_S_PARM, &parm) < 0)
+	{
+		cerr << "WARNING : Failed to set framerate on camera " << Name << endl;
+	}
+
+	v4l2_requestbuffers req;
+	memset(&req, 0, sizeof(req));
+	req.count = max(2, GetCaptureConfig().BufferCount);
+	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0 || req.count < 2)
+	{
+		cerr << "Failed to request buffers for camera " << Name << " : " << strerror(errno) << endl;
+		StopFeed();
+		return false;
+	}
+
+	Buffers.resize(req.count);
+	for (size_t i = 0; i < Buffers.size(); i++)
+	{
+		v4l2_buffer buf;
+		memset(&buf, 0, sizeof(buf));
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = i;
+		if (xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0)
+		{
+			cerr << "Failed to query buffer " << i << " for camera " << Name << endl;
+			Buffers.resize(i);
+			StopFeed();
+			return false;
+		}
+		Buffers[i].length = buf.length;
+		Buffers[i].start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+		if (Buffers[i].start == MAP_FAILED)
+		{
+			cerr << "Failed to map buffer " << i << " for camera " << Name << endl;
+			Buffers.resize(i);
+			StopFeed();
+			return false;
+		}
+		if (!Enqueue(i))
+		{
+			Buffers.resize(i+1);
+			StopFeed();
+			return false;
+		}
+	}
+
+	v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (xioctl(fd, VIDIOC_STREAMON, &type) < 0)
+	{
+		cerr << "Failed to start streaming on camera " << Name << " : " << strerror(errno) << endl;
+		StopFeed();
+		return false;
+	}
+
+	connected = true;
+	return true;
+}
+
+bool CameraV4L2Native::Dequeue(v4l2_buffer &buf)
+{
+	pollfd pfd = {fd, POLLIN, 0};
+	int ready = poll(&pfd, 1, 1000);
+	if (ready <= 0)
+	{
+		return false;
+	}
+	memset(&buf, 0, sizeof(buf));
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	if (xioctl(fd, VIDIOC_DQBUF, &buf) < 0)
+	{
+		return false;
+	}
+	return true;
+}
+
+bool CameraV4L2Native::Enqueue(int index)
+{
+	v4l2_buffer buf;
+	memset(&buf, 0, sizeof(buf));
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (xioctl(fd, VIDIOC_QBUF, &buf) < 0)
+	{
+		cerr << "Failed to queue buffer " << index << " for camera " << Name << " : " << strerror(errno) << endl;
+		return false;
+	}
+	return true;
+}
+
+bool CameraV4L2Native::Decode(const v4l2_buffer &buf, CameraImageData &Frame)
+{
+	if (buf.flags & V4L2_BUF_FLAG_ERROR || buf.bytesused == 0)
+	{
+		return false;
+	}
+	//wrap the mapped driver memory, the decoder reads the compressed data in place
+	Mat Mapped(1, buf.bytesused, CV_8UC1, Buffers[buf.index].start);
+	if (!DecodeCompressed(Mapped, Frame))
+	{
+		return false;
+	}
+	//the driver buffer is requeued right after, only copy the compressed frame if colour decoding or recording will need it
+	if (NeedsCompressedCopy())
+	{
+		Frame.Compressed = Mapped.clone();
+	}
+	return true;
+}
+
+bool CameraV4L2Native::CaptureFrame(CameraImageData &Frame)
+{
+	v4l2_buffer buf;
+	if (!Dequeue(buf))
+	{
+		return false;
+	}
+	Frame.GrabTime = GetBufferTime(buf);
+	bool success = Decode(buf, Frame);
+	success &= Enqueue(buf.index);
+	return success;
+}
+
+bool CameraV4L2Native::Grab()
+{
+	if (!connected)
+	{
+		return false;
+	}
+	if (IsCaptureThreaded())
+	{
+		return Camera::Grab();
+	}
+	if (HasGrabbedBuffer)
+	{
+		Enqueue(GrabbedBuffer.index);
+		HasGrabbedBuffer = false;
+	}
+	if (!Dequeue(GrabbedBuffer))
+	{
+		cerr << "Failed to grab frame for camera " << Name <<endl;
+		grabbed = false;
+		RegisterError();
+		return false;
+	}
+	HasGrabbedBuffer = true;
+	RegisterNoError();
+	Camera::Grab();
+	return true;
+}
+
+bool CameraV4L2Native::Read()
+{
+	if (!connected)
+	{
+		return false;
+	}
+	if (IsCaptureThreaded())
+	{
+		return Camera::Read();
+	}
+	v4l2_buffer buf;
+	if (HasGrabbedBuffer)
+	{
+		buf = GrabbedBuffer;
+	}
+	else if (!Dequeue(buf))
+	{
+		cerr << "Failed to read frame for camera " << Name <<endl;
+		grabbed = false;
+		RegisterError();
+		return false;
+	}
+	HasGrabbedBuffer = false;
+	CameraImageData Frame;
+	bool ReadSuccess = Decode(buf, Frame);
+	Enqueue(buf.index);
+	if (!ReadSuccess)
+	{
+		cerr << "Failed to decode frame for camera " << Name <<endl;
+		grabbed = false;
+		RegisterError();
+		return false;
+	}
+	SetLastFrame(Frame);
+	RegisterNoError();
+	Camera::Read();
+	SetCaptureTime(GetBufferTime(buf));
+	return true;
+}
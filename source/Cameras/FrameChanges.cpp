@@ -0,0 +1,66 @@
+#include "Cameras/FrameChanges.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+bool FrameChanges::HasChangedSince(Rect Region, int SinceFrame) const
+{
+	if (LastChange.empty() || SinceFrame <= 0)
+	{
+		return true;
+	}
+	Region &= Rect(Point(0,0), FrameSize);
+	if (Region.area() == 0)
+	{
+		return false;
+	}
+	Rect cells(Point(Region.x / CellSize, Region.y / CellSize), 
+		Point((Region.br().x + CellSize - 1) / CellSize, (Region.br().y + CellSize - 1) / CellSize));
+	cells &= Rect(Point(0,0), LastChange.size());
+	if (cells.area() == 0)
+	{
+		return false;
+	}
+	double newest;
+	minMaxLoc(LastChange(cells), nullptr, &newest);
+	return newest > SinceFrame;
+}
+
+shared_ptr<const FrameChanges> FrameChangeTracker::Update(const UMat &Source, Size FrameSize)
+{
+	if (Source.empty())
+	{
+		return nullptr;
+	}
+	FrameIndex++;
+	Size GridSize((FrameSize.width + CellSize - 1) / CellSize, (FrameSize.height + CellSize - 1) / CellSize);
+	resize(Source, Small, GridSize, 0, 0, INTER_AREA);
+	if (Small.channels() == 3)
+	{
+		cvtColor(Small, Small, COLOR_BGR2GRAY);
+	}
+	Mat current = Small.getMat(ACCESS_READ);
+	if (Reference.size() != GridSize)
+	{
+		//first frame or new resolution : everything changed
+		current.copyTo(Reference);
+		LastChange.create(GridSize, CV_32SC1);
+		LastChange.setTo(FrameIndex);
+	}
+	else
+	{
+		Mat difference, changed;
+		absdiff(current, Reference, difference);
+		compare(difference, ChangeThreshold, changed, CMP_GT);
+		LastChange.setTo(FrameIndex, changed);
+		current.copyTo(Reference, changed);
+	}
+	auto changes = make_shared<FrameChanges>();
+	changes->FrameIndex = FrameIndex;
+	changes->FrameSize = FrameSize;
+	changes->CellSize = CellSize;
+	changes->LastChange = LastChange.clone();
+	return changes;
+}
@@ -0,0 +1,181 @@
+#include "Cameras/FrameRecorder.hpp"
+
+#include <iostream>
+#include <fstream>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <Transport/thread-rename.hpp>
+
+using namespace cv;
+using namespace std;
+
+FrameRecorder::FrameRecorder(size_t InMaxQueueSize, int NumEncoders, RecordDropPolicy InDropPolicy, filesystem::path ContainerPath)
+	:MaxQueueSize(max<size_t>(1, InMaxQueueSize)), DropPolicy(InDropPolicy)
+{
+	if (!ContainerPath.empty())
+	{
+		Container = make_unique<RecordingWriter>(ContainerPath);
+	}
+	NumEncoders = max(1, NumEncoders);
+	for (int i = 0; i < NumEncoders; i++)
+	{
+		Encoders.push_back(make_unique<thread>(&FrameRecorder::EncoderThreadEntryPoint, this));
+	}
+}
+
+FrameRecorder::FrameRecorder(filesystem::path ContainerPath)
+	:FrameRecorder(GetRecordingConfig().QueueSize, GetRecordingConfig().EncoderThreads, (RecordDropPolicy)GetRecordingConfig().DropPolicy, ContainerPath)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	{
+		unique_lock lock(QueueMutex);
+		Stopping = true;
+	}
+	JobAvailable.notify_all();
+	SpaceAvailable.notify_all();
+	for (auto &encoder : Encoders)
+	{
+		encoder->join();
+	}
+	if (Container)
+	{
+		Container->Close();
+	}
+	PrintStats();
+}
+
+bool FrameRecorder::WriteJob(const RecordingJob &Job)
+{
+	error_code ec;
+	filesystem::create_directories(Job.Path.parent_path(), ec);
+	if (!Job.Compressed.empty())
+	{
+		ofstream file(Job.Path, ios::binary | ios::trunc);
+		file.write((const char*)Job.Compressed.data, Job.Compressed.total() * Job.Compressed.elemSize());
+		return file.good();
+	}
+	if (Job.Image.empty())
+	{
+		return false;
+	}
+	try
+	{
+		return imwrite(Job.Path.string(), Job.Image);
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Failed to record frame : " << e.what() << '\n';
+		return false;
+	}
+}
+
+bool FrameRecorder::WriteToContainer(const RecordingJob &Job)
+{
+	if (!Job.Settings)
+	{
+		return false;
+	}
+	uint32_t CameraIndex = Container->GetCameraIndex(Job.CameraName, *Job.Settings);
+	if (!Job.Compressed.empty())
+	{
+		return Container->AddFrame(CameraIndex, Job.GrabTime, Job.FrameNumber, Job.Pose, Job.PositionLocked,
+			Job.Compressed.data, Job.Compressed.total() * Job.Compressed.elemSize());
+	}
+	if (Job.Image.empty())
+	{
+		return false;
+	}
+	vector<uchar> Encoded;
+	if (!imencode(".jpg", Job.Image, Encoded))
+	{
+		return false;
+	}
+	return Container->AddFrame(CameraIndex, Job.GrabTime, Job.FrameNumber, Job.Pose, Job.PositionLocked,
+		Encoded.data(), Encoded.size());
+}
+
+void FrameRecorder::EncoderThreadEntryPoint()
+{
+	SetThreadName("FrameRecorder");
+	while (true)
+	{
+		RecordingJob Job;
+		{
+			unique_lock lock(QueueMutex);
+			JobAvailable.wait(lock, [this]{return Stopping || !Queue.empty();});
+			if (Queue.empty())
+			{
+				return;
+			}
+			Job = move(Queue.front());
+			Queue.pop_front();
+		}
+		SpaceAvailable.notify_one();
+		bool success = Container ? WriteToContainer(Job) : WriteJob(Job);
+		if (!success)
+		{
+			cerr << "Failed to record frame of " << Job.CameraName << " to " << (Container ? "recording" : Job.Path.string()) << endl;
+		}
+		unique_lock lock(QueueMutex);
+		(success ? Written : Failed)++;
+	}
+}
+
+bool FrameRecorder::Enqueue(RecordingJob Job)
+{
+	{
+		unique_lock lock(QueueMutex);
+		if (Stopping)
+		{
+			return false;
+		}
+		if (Queue.size() >= MaxQueueSize)
+		{
+			switch (DropPolicy)
+			{
+			case RecordDropPolicy::DropOldest:
+				Queue.pop_front();
+				Dropped++;
+				break;
+			case RecordDropPolicy::Block:
+				SpaceAvailable.wait(lock, [this]{return Stopping || Queue.size() < MaxQueueSize;});
+				if (Stopping)
+				{
+					return false;
+				}
+				break;
+			case RecordDropPolicy::DropNewest:
+			default:
+				Dropped++;
+				return false;
+			}
+		}
+		Queue.push_back(move(Job));
+		MaxQueueDepth = max(MaxQueueDepth, Queue.size());
+	}
+	JobAvailable.notify_one();
+	return true;
+}
+
+FrameRecorder::Stats FrameRecorder::GetStats() const
+{
+	unique_lock lock(QueueMutex);
+	Stats stats;
+	stats.Written = Written;
+	stats.Dropped = Dropped;
+	stats.Failed = Failed;
+	stats.QueueDepth = Queue.size();
+	stats.MaxQueueDepth = MaxQueueDepth;
+	return stats;
+}
+
+void FrameRecorder::PrintStats() const
+{
+	Stats stats = GetStats();
+	cout << "Recorder : " << stats.Written << " written, " << stats.Dropped << " dropped, "
+		<< stats.Failed << " failed, queue depth " << stats.QueueDepth << " (max " << stats.MaxQueueDepth << ")" << endl;
+}
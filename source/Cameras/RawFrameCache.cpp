@@ -0,0 +1,214 @@
+#include "Cameras/RawFrameCache.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace cv;
+using namespace std;
+
+static const char CacheMagic[8] = {'C', 'Y', 'R', 'A', 'W', 'F', 'R', '\0'};
+static const uint32_t CacheVersion = 1;
+//frames start on a page boundary, so that they can be used as host memory by OpenCL without a copy
+static const size_t CachePageSize = 4096;
+
+//Caches opened so far, never closed (see RawFrameCache::Open)
+static map<pair<filesystem::path, int>, shared_ptr<RawFrameCache>> OpenedCaches;
+static mutex OpenedCachesMutex;
+
+static size_t RoundToPage(size_t Size)
+{
+	return (Size + CachePageSize - 1) / CachePageSize * CachePageSize;
+}
+
+static filesystem::path GetCachePath(const filesystem::path &VideoPath, int Type)
+{
+	filesystem::path path = VideoPath;
+	path += Type == CV_8UC1 ? ".gray.rawframes" : ".bgr.rawframes";
+	return path;
+}
+
+static bool BuildCache(const filesystem::path &VideoPath, const filesystem::path &CachePath, int Type, uint64_t SourceSize, int64_t SourceTime)
+{
+	VideoCapture video(VideoPath.string());
+	if (!video.isOpened())
+	{
+		cerr << "Failed to open " << VideoPath << " to pre-decode it" << endl;
+		return false;
+	}
+	cout << "Pre-decoding " << VideoPath << " to " << CachePath << "..." << endl;
+	RawFrameCache::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CacheMagic, sizeof(header.Magic));
+	header.Version = CacheVersion;
+	header.Type = Type;
+	header.Framerate = video.get(CAP_PROP_FPS);
+	header.SourceSize = SourceSize;
+	header.SourceTime = SourceTime;
+
+	//write to a temporary file then rename, so that a crash can't leave a truncated cache behind
+	filesystem::path temppath = CachePath;
+	temppath += ".tmp";
+	ofstream file(temppath, ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		cerr << "Failed to create raw frame cache " << CachePath << endl;
+		return false;
+	}
+	vector<char> padding(CachePageSize, 0);
+	file.write(padding.data(), CachePageSize);
+	Mat frame, converted;
+	while (video.read(frame) && file.good())
+	{
+		if (Type == CV_8UC1)
+		{
+			cvtColor(frame, converted, COLOR_BGR2GRAY);
+		}
+		else
+		{
+			converted = frame.isContinuous() ? frame : frame.clone();
+		}
+		if (header.FrameCount == 0)
+		{
+			header.Width = converted.cols;
+			header.Height = converted.rows;
+			header.FrameStride = RoundToPage(converted.total() * converted.elemSize());
+		}
+		else if (converted.cols != header.Width || converted.rows != header.Height)
+		{
+			cerr << "WARNING : Frame " << header.FrameCount << " of " << VideoPath << " changes size, stopping the cache there" << endl;
+			break;
+		}
+		size_t FrameBytes = converted.total() * converted.elemSize();
+		file.write((const char*)converted.data, FrameBytes);
+		file.write(padding.data(), header.FrameStride - FrameBytes);
+		header.FrameCount++;
+	}
+	if (header.Framerate <= 0)
+	{
+		cerr << "WARNING : " << VideoPath << " has no framerate, assuming 30fps" << endl;
+		header.Framerate = 30;
+	}
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	file.close();
+	error_code ec;
+	if (!file.good() || header.FrameCount == 0)
+	{
+		cerr << "Failed to write raw frame cache " << CachePath << endl;
+		filesystem::remove(temppath, ec);
+		return false;
+	}
+	filesystem::rename(temppath, CachePath, ec);
+	if (ec)
+	{
+		cerr << "Failed to write raw frame cache " << CachePath << " : " << ec.message() << endl;
+		filesystem::remove(temppath, ec);
+		return false;
+	}
+	cout << "Pre-decoded " << header.FrameCount << " frames of " << VideoPath << " ("
+		<< header.FrameCount * header.FrameStride / (1<<20) << "MiB)" << endl;
+	return true;
+}
+
+RawFrameCache::RawFrameCache(filesystem::path InPath)
+	:Path(InPath)
+{
+	memset(&Info, 0, sizeof(Info));
+}
+
+RawFrameCache::~RawFrameCache()
+{
+	if (Data)
+	{
+		munmap(Data, Size);
+	}
+}
+
+bool RawFrameCache::Map(int Type, uint64_t SourceSize, int64_t SourceTime)
+{
+	int fd = open(Path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat filestat;
+	if (fstat(fd, &filestat) < 0 || (size_t)filestat.st_size < CachePageSize)
+	{
+		close(fd);
+		return false;
+	}
+	Header header;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+		|| memcmp(header.Magic, CacheMagic, sizeof(header.Magic)) != 0 || header.Version != CacheVersion
+		|| header.Type != Type || header.SourceSize != SourceSize || header.SourceTime != SourceTime
+		|| header.FrameStride < (uint64_t)header.Width * header.Height * CV_ELEM_SIZE(Type)
+		|| (size_t)filestat.st_size < CachePageSize + header.FrameCount * header.FrameStride)
+	{
+		close(fd);
+		return false;
+	}
+	//private and writable : frames are handed out as regular images, a stray write stays in memory instead of crashing or touching the file
+	void* mapped = mmap(nullptr, filestat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		cerr << "Failed to map raw frame cache " << Path << " : " << strerror(errno) << endl;
+		return false;
+	}
+	//playback goes forward
+	madvise(mapped, filestat.st_size, MADV_SEQUENTIAL);
+	Data = (uint8_t*)mapped;
+	Size = filestat.st_size;
+	Info = header;
+	return true;
+}
+
+shared_ptr<RawFrameCache> RawFrameCache::Open(const filesystem::path &VideoPath, int Type)
+{
+	filesystem::path SourcePath = filesystem::weakly_canonical(VideoPath);
+	lock_guard lock(OpenedCachesMutex);
+	auto found = OpenedCaches.find({SourcePath, Type});
+	if (found != OpenedCaches.end())
+	{
+		return found->second;
+	}
+	error_code ec;
+	uint64_t SourceSize = filesystem::file_size(SourcePath, ec);
+	if (ec)
+	{
+		cerr << "Can't pre-decode " << SourcePath << " : " << ec.message() << endl;
+		return nullptr;
+	}
+	int64_t SourceTime = filesystem::last_write_time(SourcePath, ec).time_since_epoch().count();
+	filesystem::path CachePath = GetCachePath(SourcePath, Type);
+	shared_ptr<RawFrameCache> cache(new RawFrameCache(CachePath));
+	if (!cache->Map(Type, SourceSize, SourceTime))
+	{
+		if (!BuildCache(SourcePath, CachePath, Type, SourceSize, SourceTime) || !cache->Map(Type, SourceSize, SourceTime))
+		{
+			return nullptr;
+		}
+	}
+	OpenedCaches[{SourcePath, Type}] = cache;
+	return cache;
+}
+
+Mat RawFrameCache::GetFrame(size_t Index) const
+{
+	if (!Data || Index >= Info.FrameCount)
+	{
+		return Mat();
+	}
+	return Mat(Info.Height, Info.Width, Info.Type, Data + CachePageSize + Index * Info.FrameStride);
+}
@@ -0,0 +1,333 @@
+#include "Cameras/RecordingFile.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <nlohmann/json.hpp>
+#include <Cameras/Calibfile.hpp>
+
+using namespace cv;
+using namespace std;
+using namespace RecordingFormat;
+
+static int64_t TimeToNs(chrono::steady_clock::time_point Time)
+{
+	return chrono::duration_cast<chrono::nanoseconds>(Time.time_since_epoch()).count();
+}
+
+static chrono::steady_clock::time_point NsToTime(int64_t Time)
+{
+	return chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(Time)));
+}
+
+RecordingWriter::RecordingWriter(filesystem::path Path)
+{
+	error_code ec;
+	filesystem::create_directories(Path.parent_path(), ec);
+	File.open(Path, ios::binary | ios::trunc);
+	if (!File.is_open())
+	{
+		cerr << "Failed to create recording " << Path << endl;
+		return;
+	}
+	FileHeader header;
+	memcpy(header.Magic, FileMagic, sizeof(header.Magic));
+	header.Version = Version;
+	header.Reserved = 0;
+	File.write((const char*)&header, sizeof(header));
+	Offset = sizeof(header);
+}
+
+RecordingWriter::~RecordingWriter()
+{
+	Close();
+}
+
+bool RecordingWriter::WriteChunk(ChunkType Type, uint32_t Camera, int64_t GrabTime,
+	const void* Header, size_t HeaderSize, const void* Data, size_t DataSize)
+{
+	if (!File.is_open())
+	{
+		return false;
+	}
+	ChunkHeader chunk;
+	chunk.Type = Type;
+	chunk.Camera = Camera;
+	chunk.PayloadSize = HeaderSize + DataSize;
+	File.write((const char*)&chunk, sizeof(chunk));
+	if (HeaderSize)
+	{
+		File.write((const char*)Header, HeaderSize);
+	}
+	if (DataSize)
+	{
+		File.write((const char*)Data, DataSize);
+	}
+	if (Type != ChunkType::Index)
+	{
+		Index.push_back({Offset, Type, Camera, GrabTime});
+	}
+	Offset += sizeof(chunk) + chunk.PayloadSize;
+	return File.good();
+}
+
+uint32_t RecordingWriter::GetCameraIndex(const string &Name, const CameraSettings &Settings)
+{
+	lock_guard lock(Mutex);
+	auto found = CameraIndices.find(Name);
+	if (found != CameraIndices.end())
+	{
+		return found->second;
+	}
+	uint32_t index = CameraIndices.size();
+	CameraIndices[Name] = index;
+	nlohmann::json description;
+	description["name"] = Name;
+	description["calibration"] = CameraParametersToJson(Settings);
+	string serialized = description.dump();
+	WriteChunk(ChunkType::Camera, index, 0, nullptr, 0, serialized.data(), serialized.size());
+	return index;
+}
+
+bool RecordingWriter::AddFrame(uint32_t Camera, chrono::steady_clock::time_point GrabTime, uint32_t FrameNumber,
+	Affine3d Pose, bool PositionLocked, const void* Jpeg, size_t JpegSize)
+{
+	FrameHeader header;
+	header.GrabTime = TimeToNs(GrabTime);
+	header.FrameNumber = FrameNumber;
+	header.Flags = PositionLocked ? FrameFlags::PositionLocked : 0;
+	memcpy(header.Pose, Pose.matrix.val, sizeof(header.Pose));
+	lock_guard lock(Mutex);
+	return WriteChunk(ChunkType::Frame, Camera, header.GrabTime, &header, sizeof(header), Jpeg, JpegSize);
+}
+
+void RecordingWriter::Close()
+{
+	lock_guard lock(Mutex);
+	if (!File.is_open())
+	{
+		return;
+	}
+	Footer footer;
+	footer.IndexOffset = Offset;
+	memcpy(footer.Magic, FooterMagic, sizeof(footer.Magic));
+	WriteChunk(ChunkType::Index, 0, 0, nullptr, 0, Index.data(), Index.size() * sizeof(IndexEntry));
+	File.write((const char*)&footer, sizeof(footer));
+	File.close();
+}
+
+//Recordings currently opened, so that the cameras of one recording share the mapping
+static map<filesystem::path, weak_ptr<RecordingReader>> OpenedRecordings;
+static mutex OpenedRecordingsMutex;
+
+RecordingReader::RecordingReader(filesystem::path InPath)
+	:Path(InPath)
+{
+	int fd = open(Path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		cerr << "Failed to open recording " << Path << " : " << strerror(errno) << endl;
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(FileHeader))
+	{
+		cerr << "Recording " << Path << " is empty" << endl;
+		close(fd);
+		return;
+	}
+	Size = info.st_size;
+	void* mapped = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		cerr << "Failed to map recording " << Path << " : " << strerror(errno) << endl;
+		Size = 0;
+		return;
+	}
+	Data = (const uint8_t*)mapped;
+	//playback goes forward
+	madvise(mapped, Size, MADV_SEQUENTIAL);
+
+	FileHeader header;
+	memcpy(&header, Data, sizeof(header));
+	if (memcmp(header.Magic, FileMagic, sizeof(header.Magic)) != 0 || header.Version != Version)
+	{
+		cerr << "File " << Path << " is not a recording, or from an unsupported version" << endl;
+		return;
+	}
+	vector<IndexEntry> Index;
+	if (!ReadIndex(Index))
+	{
+		cerr << "Recording " << Path << " was not closed properly, rebuilding its index" << endl;
+		RebuildIndex(Index);
+	}
+	ReadChunks(Index);
+}
+
+RecordingReader::~RecordingReader()
+{
+	if (Data)
+	{
+		munmap((void*)Data, Size);
+	}
+}
+
+bool RecordingReader::ReadIndex(vector<IndexEntry> &Index) const
+{
+	if (Size < sizeof(FileHeader) + sizeof(ChunkHeader) + sizeof(Footer))
+	{
+		return false;
+	}
+	Footer footer;
+	memcpy(&footer, Data + Size - sizeof(Footer), sizeof(footer));
+	if (memcmp(footer.Magic, FooterMagic, sizeof(footer.Magic)) != 0
+		|| footer.IndexOffset < sizeof(FileHeader) || footer.IndexOffset + sizeof(ChunkHeader) + sizeof(Footer) > Size)
+	{
+		return false;
+	}
+	ChunkHeader chunk;
+	memcpy(&chunk, Data + footer.IndexOffset, sizeof(chunk));
+	if (chunk.Type != ChunkType::Index || chunk.PayloadSize % sizeof(IndexEntry) != 0
+		|| footer.IndexOffset + sizeof(ChunkHeader) + chunk.PayloadSize + sizeof(Footer) != Size)
+	{
+		return false;
+	}
+	Index.resize(chunk.PayloadSize / sizeof(IndexEntry));
+	memcpy(Index.data(), Data + footer.IndexOffset + sizeof(ChunkHeader), chunk.PayloadSize);
+	return true;
+}
+
+void RecordingReader::RebuildIndex(vector<IndexEntry> &Index) const
+{
+	Index.clear();
+	uint64_t offset = sizeof(FileHeader);
+	while (offset + sizeof(ChunkHeader) <= Size)
+	{
+		ChunkHeader chunk;
+		memcpy(&chunk, Data + offset, sizeof(chunk));
+		if (chunk.Type == ChunkType::Index || chunk.PayloadSize > Size - offset - sizeof(ChunkHeader))
+		{
+			//end of the chunks, or truncated by a crash
+			break;
+		}
+		int64_t GrabTime = 0;
+		if (chunk.Type == ChunkType::Frame && chunk.PayloadSize >= sizeof(FrameHeader))
+		{
+			memcpy(&GrabTime, Data + offset + sizeof(ChunkHeader) + offsetof(FrameHeader, GrabTime), sizeof(GrabTime));
+		}
+		Index.push_back({offset, chunk.Type, chunk.Camera, GrabTime});
+		offset += sizeof(ChunkHeader) + chunk.PayloadSize;
+	}
+}
+
+bool RecordingReader::ReadChunks(const vector<IndexEntry> &Index)
+{
+	vector<bool> CameraValid;
+	for (auto &entry : Index)
+	{
+		if (entry.Offset + sizeof(ChunkHeader) > Size)
+		{
+			continue;
+		}
+		ChunkHeader chunk;
+		memcpy(&chunk, Data + entry.Offset, sizeof(chunk));
+		const uint8_t* payload = Data + entry.Offset + sizeof(ChunkHeader);
+		if (chunk.PayloadSize > Size - entry.Offset - sizeof(ChunkHeader))
+		{
+			continue;
+		}
+		switch (chunk.Type)
+		{
+		case ChunkType::Camera:
+		{
+			if (chunk.Camera >= Cameras.size())
+			{
+				Cameras.resize(chunk.Camera + 1);
+				CameraValid.resize(chunk.Camera + 1, false);
+			}
+			RecordedCamera &camera = Cameras[chunk.Camera];
+			try
+			{
+				auto description = nlohmann::json::parse(string((const char*)payload, chunk.PayloadSize));
+				camera.Name = description.at("name").get<string>();
+				CameraValid[chunk.Camera] = JsonToCameraParameters(description.at("calibration"), camera.Settings);
+				//undistortion maps get cached next to the recording
+				camera.Settings.CalibrationFile = Path;
+			}
+			catch(const std::exception& e)
+			{
+				std::cerr << "Invalid camera in recording " << Path << " : " << e.what() << '\n';
+			}
+			break;
+		}
+		case ChunkType::Frame:
+		{
+			if (chunk.Camera >= Cameras.size() || !CameraValid[chunk.Camera] || chunk.PayloadSize <= sizeof(FrameHeader))
+			{
+				break;
+			}
+			FrameHeader header;
+			memcpy(&header, payload, sizeof(header));
+			RecordedFrame frame;
+			frame.GrabTime = NsToTime(header.GrabTime);
+			frame.FrameNumber = header.FrameNumber;
+			frame.Pose = Affine3d(Matx44d(header.Pose));
+			frame.PositionLocked = header.Flags & FrameFlags::PositionLocked;
+			frame.Jpeg = Mat(1, chunk.PayloadSize - sizeof(FrameHeader), CV_8UC1, (void*)(payload + sizeof(FrameHeader)));
+			Cameras[chunk.Camera].Frames.push_back(frame);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	//drop the cameras that could not be read
+	for (size_t i = Cameras.size(); i > 0; i--)
+	{
+		if (!CameraValid[i-1])
+		{
+			Cameras.erase(Cameras.begin() + i - 1);
+		}
+	}
+	bool HasStart = false;
+	for (auto &camera : Cameras)
+	{
+		sort(camera.Frames.begin(), camera.Frames.end(),
+			[](const RecordedFrame &a, const RecordedFrame &b){return a.GrabTime < b.GrabTime;});
+		if (camera.Frames.size() > 0 && (!HasStart || camera.Frames[0].GrabTime < StartTime))
+		{
+			StartTime = camera.Frames[0].GrabTime;
+			HasStart = true;
+		}
+	}
+	return Cameras.size() > 0;
+}
+
+shared_ptr<RecordingReader> RecordingReader::Open(filesystem::path Path)
+{
+	Path = filesystem::weakly_canonical(Path);
+	lock_guard lock(OpenedRecordingsMutex);
+	auto found = OpenedRecordings.find(Path);
+	if (found != OpenedRecordings.end())
+	{
+		auto reader = found->second.lock();
+		if (reader)
+		{
+			return reader;
+		}
+	}
+	shared_ptr<RecordingReader> reader(new RecordingReader(Path));
+	if (reader->Cameras.size() == 0)
+	{
+		return nullptr;
+	}
+	OpenedRecordings[Path] = reader;
+	return reader;
+}
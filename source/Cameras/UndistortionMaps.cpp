@@ -0,0 +1,325 @@
+#include "Cameras/UndistortionMaps.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+//Maps currently used by at least one camera
+static map<string, weak_ptr<const UndistortionMaps>> LoadedMaps;
+static mutex LoadedMapsMutex;
+//Held while the maps of a key are loaded or computed, so that cameras sharing a calibration build it once
+//and cameras with other calibrations don't wait for it
+static map<string, shared_ptr<mutex>> BuildMutexes;
+
+static const char CacheMagic[4] = {'C', 'Y', 'U', 'M'};
+static const uint32_t CacheVersion = 1;
+
+//FNV-1a
+static void HashBytes(uint64_t &hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+static void HashMatrix(uint64_t &hash, const Mat &matrix)
+{
+	Mat asdouble;
+	matrix.convertTo(asdouble, CV_64F);
+	int32_t size[2] = {asdouble.rows, asdouble.cols};
+	HashBytes(hash, size, sizeof(size));
+	for (int row = 0; row < asdouble.rows; row++)
+	{
+		HashBytes(hash, asdouble.ptr(row), asdouble.cols * asdouble.elemSize());
+	}
+}
+
+string GetUndistortionMapsKey(const vector<LensSettings> &Lenses, Size Resolution)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto &lens : Lenses)
+	{
+		int32_t roi[4] = {lens.ROI.x, lens.ROI.y, lens.ROI.width, lens.ROI.height};
+		HashBytes(hash, roi, sizeof(roi));
+		HashMatrix(hash, lens.CameraMatrix);
+		HashMatrix(hash, lens.distanceCoeffs);
+	}
+	char buffer[64] = {0};
+	snprintf(buffer, sizeof(buffer)-1, "%016llx_%dx%d", (unsigned long long)hash, Resolution.width, Resolution.height);
+	return string(buffer);
+}
+
+static filesystem::path GetCachePath(const filesystem::path &CalibrationFile, const string &Key)
+{
+	filesystem::path path = CalibrationFile;
+	path.replace_filename(CalibrationFile.stem().string() + "_" + Key + ".undistmap");
+	return path;
+}
+
+static bool ReadCachedMaps(const filesystem::path &path, Size Resolution, Mat &Map1, Mat &Map2)
+{
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	char magic[4];
+	uint32_t version;
+	int32_t width, height;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&width, sizeof(width));
+	file.read((char*)&height, sizeof(height));
+	if (!file.good() || memcmp(magic, CacheMagic, sizeof(magic)) != 0 || version != CacheVersion
+		|| width != Resolution.width || height != Resolution.height)
+	{
+		return false;
+	}
+	Map1.create(Resolution, CV_16SC2);
+	Map2.create(Resolution, CV_16UC1);
+	file.read((char*)Map1.data, Map1.total() * Map1.elemSize());
+	file.read((char*)Map2.data, Map2.total() * Map2.elemSize());
+	return file.good();
+}
+
+static bool WriteCachedMaps(const filesystem::path &path, const Mat &Map1, const Mat &Map2)
+{
+	//write to a temporary file then rename, so that a crash can't leave a truncated cache behind
+	filesystem::path temppath = path;
+	temppath += ".tmp";
+	{
+		ofstream file(temppath, ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			cerr << "WARNING : Failed to write undistortion maps cache to " << path << endl;
+			return false;
+		}
+		uint32_t version = CacheVersion;
+		int32_t width = Map1.cols, height = Map1.rows;
+		file.write(CacheMagic, sizeof(CacheMagic));
+		file.write((const char*)&version, sizeof(version));
+		file.write((const char*)&width, sizeof(width));
+		file.write((const char*)&height, sizeof(height));
+		file.write((const char*)Map1.data, Map1.total() * Map1.elemSize());
+		file.write((const char*)Map2.data, Map2.total() * Map2.elemSize());
+		if (!file.good())
+		{
+			cerr << "WARNING : Failed to write undistortion maps cache to " << path << endl;
+			file.close();
+			filesystem::remove(temppath);
+			return false;
+		}
+	}
+	error_code ec;
+	filesystem::rename(temppath, path, ec);
+	if (ec)
+	{
+		cerr << "WARNING : Failed to write undistortion maps cache to " << path << " : " << ec.message() << endl;
+		filesystem::remove(temppath, ec);
+		return false;
+	}
+	return true;
+}
+
+//Remove the caches of older calibrations of this file at this resolution, they won't be read again and weigh tens of MB each
+static void RemoveStaleCaches(const filesystem::path &CalibrationFile, const filesystem::path &CurrentCache, Size Resolution)
+{
+	const string prefix = CalibrationFile.stem().string() + "_";
+	char suffix[64] = {0};
+	snprintf(suffix, sizeof(suffix)-1, "_%dx%d.undistmap", Resolution.width, Resolution.height);
+	const string suffixstr(suffix);
+	//<stem>_<16 hex digits hash>_<resolution>.undistmap
+	const size_t namelength = prefix.size() + 16 + suffixstr.size();
+	error_code ec;
+	filesystem::path directory = CurrentCache.parent_path().empty() ? filesystem::path(".") : CurrentCache.parent_path();
+	for (auto &entry : filesystem::directory_iterator(directory, ec))
+	{
+		string name = entry.path().filename().string();
+		if (name.size() != namelength || name.compare(0, prefix.size(), prefix) != 0 
+			|| name.compare(name.size() - suffixstr.size(), suffixstr.size(), suffixstr) != 0 
+			|| entry.path().filename() == CurrentCache.filename())
+		{
+			continue;
+		}
+		error_code removeec;
+		if (filesystem::remove(entry.path(), removeec))
+		{
+			cout << "Removed stale undistortion maps cache " << entry.path() << endl;
+		}
+	}
+}
+
+static void ComputeMaps(const vector<LensSettings> &Lenses, Size Resolution, Mat &Map1, Mat &Map2)
+{
+	Mat floatmap1(Resolution, CV_32FC1, Scalar(-1)), floatmap2(Resolution, CV_32FC1, Scalar(-1));
+	for (auto &lens : Lenses)
+	{
+		initUndistortRectifyMap(lens.CameraMatrix, lens.distanceCoeffs, Mat::eye(3,3, CV_64F),
+		lens.CameraMatrix, lens.ROI.size(), CV_32FC1, floatmap1(lens.ROI), floatmap2(lens.ROI));
+	}
+	//fixed-point maps are half the size of the float maps, so remap reads half as much
+	convertMaps(floatmap1, floatmap2, Map1, Map2, CV_16SC2, false);
+}
+
+shared_ptr<const UndistortionMaps> GetUndistortionMaps(const vector<LensSettings> &Lenses, Size Resolution,
+	filesystem::path CalibrationFile)
+{
+	if (Lenses.size() == 0 || Resolution.width <= 0 || Resolution.height <= 0)
+	{
+		return nullptr;
+	}
+	Rect2i FrameRect(Point2i(0,0), Resolution);
+	for (auto &lens : Lenses)
+	{
+		if (lens.CameraMatrix.size() != Size(3,3) || (lens.ROI & FrameRect) != lens.ROI)
+		{
+			return nullptr;
+		}
+	}
+
+	string key = GetUndistortionMapsKey(Lenses, Resolution);
+	auto FindLoaded = [&key]() -> shared_ptr<const UndistortionMaps>
+	{
+		auto found = LoadedMaps.find(key);
+		return found != LoadedMaps.end() ? found->second.lock() : nullptr;
+	};
+	shared_ptr<mutex> BuildMutex;
+	{
+		lock_guard lock(LoadedMapsMutex);
+		auto maps = FindLoaded();
+		if (maps)
+		{
+			return maps;
+		}
+		auto &buildmutex = BuildMutexes[key];
+		if (!buildmutex)
+		{
+			buildmutex = make_shared<mutex>();
+		}
+		BuildMutex = buildmutex;
+	}
+	//loading and computing happen outside LoadedMapsMutex
+	lock_guard buildlock(*BuildMutex);
+	{
+		//another camera with the same calibration may have built them while this one waited
+		lock_guard lock(LoadedMapsMutex);
+		auto maps = FindLoaded();
+		if (maps)
+		{
+			return maps;
+		}
+	}
+
+	Mat Map1, Map2;
+	bool cached = false;
+	filesystem::path cachepath;
+	if (!CalibrationFile.empty())
+	{
+		cachepath = GetCachePath(CalibrationFile, key);
+		cached = ReadCachedMaps(cachepath, Resolution, Map1, Map2);
+	}
+	if (!cached)
+	{
+		ComputeMaps(Lenses, Resolution, Map1, Map2);
+		if (!cachepath.empty() && WriteCachedMaps(cachepath, Map1, Map2))
+		{
+			//the calibration changed : the caches of the previous ones are never going to be used
+			RemoveStaleCaches(CalibrationFile, cachepath, Resolution);
+		}
+	}
+
+	auto maps = make_shared<UndistortionMaps>();
+	Map1.copyTo(maps->Map1);
+	Map2.copyTo(maps->Map2);
+	lock_guard lock(LoadedMapsMutex);
+	LoadedMaps[key] = maps;
+	return maps;
+}
+
+SparseUndistortedFrame::SparseUndistortedFrame(UMat InSource, UMat InDestination, shared_ptr<const UndistortionMaps> InMaps, unsigned int InFrameNumber,
+	Size InTileSize)
+	:Maps(InMaps), Source(InSource), Destination(InDestination), FrameNumber(InFrameNumber), TileSize(InTileSize), NumTilesDone(0)
+{
+	if (Destination.size() != Source.size() || Destination.type() != Source.type())
+	{
+		Destination.create(Source.size(), Source.type());
+	}
+	NumTiles = Size((Source.cols + TileSize.width - 1) / TileSize.width, (Source.rows + TileSize.height - 1) / TileSize.height);
+	TilesDone.resize(NumTiles.area(), false);
+}
+
+void SparseUndistortedFrame::UndistortTiles(Rect TileRange)
+{
+	Rect FrameRect(Point2i(0,0), Source.size());
+	for (int ty = TileRange.y; ty < TileRange.y + TileRange.height; ty++)
+	{
+		//remap runs of missing tiles in a single call
+		int tx = TileRange.x;
+		while (tx < TileRange.x + TileRange.width)
+		{
+			if (TilesDone[ty*NumTiles.width + tx])
+			{
+				tx++;
+				continue;
+			}
+			int runstart = tx;
+			while (tx < TileRange.x + TileRange.width && !TilesDone[ty*NumTiles.width + tx])
+			{
+				TilesDone[ty*NumTiles.width + tx] = true;
+				NumTilesDone++;
+				tx++;
+			}
+			Rect run(runstart * TileSize.width, ty * TileSize.height, (tx - runstart) * TileSize.width, TileSize.height);
+			run &= FrameRect;
+			UMat DestinationRun = Destination(run);
+			remap(Source, DestinationRun, Maps->Map1(run), Maps->Map2(run), INTER_LINEAR);
+		}
+	}
+}
+
+UMat SparseUndistortedFrame::GetRegions(const vector<Rect> &Regions)
+{
+	lock_guard lock(Mutex);
+	Rect FrameRect(Point2i(0,0), Source.size());
+	for (auto &region : Regions)
+	{
+		Rect clipped = region & FrameRect;
+		if (clipped.empty())
+		{
+			continue;
+		}
+		Point2i firsttile(clipped.x / TileSize.width, clipped.y / TileSize.height);
+		Point2i lasttile((clipped.x + clipped.width - 1) / TileSize.width, (clipped.y + clipped.height - 1) / TileSize.height);
+		UndistortTiles(Rect(firsttile, lasttile + Point2i(1,1)));
+	}
+	return Destination;
+}
+
+UMat SparseUndistortedFrame::GetFull()
+{
+	lock_guard lock(Mutex);
+	if (NumTilesDone == 0)
+	{
+		//nothing to reuse, a single remap is faster
+		remap(Source, Destination, Maps->Map1, Maps->Map2, INTER_LINEAR);
+		fill(TilesDone.begin(), TilesDone.end(), true);
+		NumTilesDone = TilesDone.size();
+	}
+	else if (NumTilesDone < TilesDone.size())
+	{
+		UndistortTiles(Rect(Point2i(0,0), NumTiles));
+	}
+	return Destination;
+}
@@ -14,6 +14,7 @@
 #include <thirdparty/serialib.h>
 
 #include <Cameras/Calibfile.hpp>
+#include <Cameras/RawFrameCache.hpp>
 #include <Misc/FrameCounter.hpp>
 
 #include <ArucoPipeline/TrackedObject.hpp> //CameraView
@@ -77,9 +78,27 @@ bool VideoCaptureCamera::StartFeed()
 	//snprintf(commandbuffer, sizeof(commandbuffer), "v4l2-ctl -d %s -c exposure_auto=%d,exposure_absolute=%d", pathtodevice.c_str(), 1, 32);
 	//cout << "Aperture system command : " << commandbuffer << endl;
 	//system(commandbuffer);
-	feed = make_unique<VideoCapture>();
-	cout << "Opening device at \"" << Settingscast->StartPath << "\" with API id " << Settingscast->ApiID << endl;
-	feed->open(Settingscast->StartPath, Settingscast->ApiID);
+	RawFrames.reset();
+	feed.reset();
+	RawFrameCacheMode CacheMode = GetRawFrameCacheMode();
+	if (Settingscast->StartType == CameraStartType::PLAYBACK && CacheMode != RawFrameCacheMode::Off)
+	{
+		RawFrames = RawFrameCache::Open(Settingscast->StartPath, CacheMode == RawFrameCacheMode::Gray ? CV_8UC1 : CV_8UC3);
+		if (RawFrames)
+		{
+			Settingscast->Resolution = RawFrames->GetFrameSize();
+		}
+		else
+		{
+			cerr << "WARNING : Could not pre-decode " << Settingscast->StartPath << ", decoding it while playing" << endl;
+		}
+	}
+	if (!RawFrames)
+	{
+		feed = make_unique<VideoCapture>();
+		cout << "Opening device at \"" << Settingscast->StartPath << "\" with API id " << Settingscast->ApiID << endl;
+		feed->open(Settingscast->StartPath, Settingscast->ApiID);
+	}
 	if (Settingscast->StartType == CameraStartType::ANY)
 	{
 		feed->set(CAP_PROP_FOURCC, VideoWriter::fourcc('M', 'J', 'P', 'G'));
@@ -95,17 +114,99 @@ bool VideoCaptureCamera::StartFeed()
 		Settingscast->Resolution.height = feed->get(CAP_PROP_FRAME_HEIGHT);
 	}
 	
+	Playback = Settingscast->StartType == CameraStartType::PLAYBACK;
+	Clock = Playback ? GetSimulationClock() : SimulationClock::Loop;
+	PlaybackStart = GetSimulationEpoch();
+	PlaybackFrameIndex = 0;
+	PlaybackFramerate = RawFrames ? RawFrames->GetFramerate() : feed->get(CAP_PROP_FPS);
+	if (PlaybackFramerate <= 0)
+	{
+		PlaybackFramerate = (double)Settings->Framerate/Settings->FramerateDivider;
+	}
 	connected = true;
 	
 	return true;
 }
 
+std::chrono::steady_clock::time_point VideoCaptureCamera::GetPlaybackTime() const
+{
+	if (Clock == SimulationClock::Loop)
+	{
+		//looping videos are decoded as fast as possible, not at video speed : file times would drift away from the wall clock
+		//that object ages are measured against, so they're stamped when read
+		return std::chrono::steady_clock::now();
+	}
+	//the position reported by the decoder depends on the backend, the frame index doesn't
+	std::chrono::duration<double> position(PlaybackFrameIndex / PlaybackFramerate);
+	return PlaybackStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(position);
+}
+
+std::chrono::steady_clock::time_point VideoCaptureCamera::AdvancePlayback()
+{
+	auto FrameTime = GetPlaybackTime();
+	PlaybackFrameIndex++;
+	if (Clock == SimulationClock::RealTime)
+	{
+		this_thread::sleep_until(FrameTime);
+	}
+	return FrameTime;
+}
+
+bool VideoCaptureCamera::ReadRawFrame(CameraImageData &Frame)
+{
+	Mat raw = RawFrames->GetFrame(PlaybackFrameIndex);
+	if (raw.empty())
+	{
+		ended = true;
+		return false;
+	}
+	//wraps the mapped frame, nothing is decoded nor copied
+	UMat frame = raw.getUMat(ACCESS_READ);
+	if (raw.channels() == 1)
+	{
+		Frame.GrayImage = frame;
+		Frame.GrayScaleDenominator = 1;
+	}
+	else
+	{
+		Frame.Image = frame;
+	}
+	Frame.GrabTime = AdvancePlayback();
+	return true;
+}
+
+bool VideoCaptureCamera::CaptureFrame(CameraImageData &Frame)
+{
+	if (RawFrames)
+	{
+		return ReadRawFrame(Frame);
+	}
+	//read writes in place when the buffer already has the right size
+	Frame.Image = FrameBuffers.Get(Settings->Resolution, CV_8UC3);
+	if (!feed->read(Frame.Image))
+	{
+		ended = Playback;
+		return false;
+	}
+	Frame.GrabTime = Playback ? AdvancePlayback() : std::chrono::steady_clock::now();
+	return true;
+}
+
 bool VideoCaptureCamera::Grab()
 {
 	if (!connected)
 	{
 		return false;
 	}
+	if (IsCaptureThreaded())
+	{
+		return Camera::Grab();
+	}
+	if (RawFrames)
+	{
+		Camera::Grab();
+		return true;
+	}
 	bool grabsuccess = false;
 	grabsuccess = feed->grab();
 	if (grabsuccess)
@@ -113,6 +214,11 @@ bool VideoCaptureCamera::Grab()
 		RegisterNoError();
 		Camera::Grab();
 	}
+	else if (Playback)
+	{
+		grabbed = false;
+		ended = true;
+	}
 	else
 	{
 		cerr << "Failed to grab frame for camera " << Name <<endl;
@@ -129,10 +235,30 @@ bool VideoCaptureCamera::Read()
 	{
 		return false;
 	}
+	if (IsCaptureThreaded())
+	{
+		return Camera::Read();
+	}
+	if (RawFrames)
+	{
+		CameraImageData Frame;
+		if (!ReadRawFrame(Frame))
+		{
+			cout << "Playback ended for camera " << Name << endl;
+			grabbed = false;
+			return false;
+		}
+		SetLastFrame(Frame);
+		RegisterNoError();
+		Camera::Read();
+		captureTime = Frame.GrabTime;
+		return true;
+	}
 	bool ReadSuccess = false;
 	bool HadGrabbed = grabbed;
-	LastFrameDistorted = UMat();
+	LastFrameDistorted = FrameBuffers.Get(Settings->Resolution, CV_8UC3);
 	LastFrameUndistorted = UMat();
+	LastFrameSparseUndistorted.reset();
 	if (HadGrabbed)
 	{
 		ReadSuccess = feed->retrieve(LastFrameDistorted);
@@ -146,6 +272,17 @@ bool VideoCaptureCamera::Read()
 	{
 		RegisterNoError();
 		Camera::Read();
+		if (Playback)
+		{
+			captureTime = AdvancePlayback();
+		}
+	}
+	else if (Playback)
+	{
+		cout << "Playback ended for camera " << Name << endl;
+		grabbed = false;
+		ended = true;
+		return false;
 	}
 	else
 	{
@@ -82,7 +82,7 @@ optional<json> JsonListener::ObjectToJson(const ObjectData& Object)
 	{
 		objectified["metadata"] = Object.metadata;
 	}
-	objectified["age"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Clock::now() - Object.LastSeen).count();
+	objectified["age"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Now() - Object.LastSeen).count();
 	
 	bool requireCoord = ObjectTypeConfig.WantPosition;
 	bool requireRot = ObjectTypeConfig.WantRotation;
@@ -171,7 +171,7 @@ ObjectData::TimePoint JsonListener::GetCutoffTime(const nlohmann::json &Query)
 	ObjectData::TimePoint OldCutoff;
 	if (maxagems >0)
 	{
-		OldCutoff = ObjectData::Clock::now() - chrono::milliseconds(maxagems);
+		OldCutoff = ObjectData::Now() - chrono::milliseconds(maxagems);
 	}
 	return OldCutoff;
 }
@@ -235,6 +235,7 @@ bool JsonListener::GetData(const json &Query, json &Response)
 		cv::Size2d fov = GetCameraFOV(data.FrameSize, data.CameraMatrix);
 		cameradata["xfov"] = round(fov.width * 180 / M_PI * 100) / 100;
 		cameradata["yfov"] = round(fov.height * 180 / M_PI * 100) / 100;
+		cameradata["latency"] = int(data.Latency*1000);
 		if (has2D || AllowedTypes.find(ObjectType::Aruco) != AllowedTypes.end())
 		{
 			cameradata["arucoObjects"] = json::array();
@@ -351,7 +352,7 @@ bool JsonListener::GetZone(const json &Query, json &Response)
 	auto OldCutoff = GetCutoffTime(Query);
 	if (OldCutoff == ObjectData::TimePoint())
 	{
-		OldCutoff = ObjectData::Clock::now() - chrono::seconds(3);
+		OldCutoff = ObjectData::Now() - chrono::seconds(3);
 	}
 	
 	set<string> SeenZones;
@@ -398,13 +399,24 @@ bool JsonListener::GetImage(double reduction, json &Response)
 	{
 		cv::UMat image;
 		auto & this_cam = cameras[i];
-		if (reduction <= 1)
+		//if the colour image was not decoded, send the luma
+		cv::UMat source = this_cam.Image.empty() ? this_cam.GrayImage : this_cam.Image;
+		if (source.empty() && this_cam.SparseUndistorted)
 		{
-			image = this_cam.Image;
+			source = this_cam.SparseUndistorted->GetFull();
+		}
+		if (source.empty())
+		{
+			continue;
+		}
+		double source_reduction = reduction / (source.size().width / (double)this_cam.GetFrameSize().width);
+		if (source_reduction <= 1)
+		{
+			image = source;
 		}
 		else
 		{
-			cv::resize(this_cam.Image, image, cv::Size(0,0), 1/reduction, 1/reduction);
+			cv::resize(source, image, cv::Size(0,0), 1/source_reduction, 1/source_reduction);
 		}
 		std::vector<uchar> jpgenc, b64enc;
 		cv::imencode(".jpg", image, jpgenc);
@@ -618,6 +630,7 @@ void JsonListener::HandleQuery(const json &Query)
 				statusbuilder << "External runner doing fine; ";
 				Response["data"]["team"] = TeamNames.at(Parent->ExternalRunner->GetTeam()).JavaName;
 				Response["data"]["idle"] = Parent->ExternalRunner->GetIdle();
+				Response["data"]["yoloBackend"] = Parent->ExternalRunner->GetYoloBackend();
 			}
 
 			if (!Parent->InternalRunner)
@@ -10,6 +10,10 @@ void CameraFeatureData::Clear()
 	ArucoSegments.clear();
 
 	YoloDetections.clear();
+	YoloGrabTime = std::chrono::steady_clock::time_point();
+
+	ROIMask.release();
+	ROIBounds = cv::Rect();
 }
 
 void CameraFeatureData::CopyEssentials(const CameraImageData &source, int lens)
@@ -19,4 +23,5 @@ void CameraFeatureData::CopyEssentials(const CameraImageData &source, int lens)
 	DistanceCoefficients = source.lenses[lens].distanceCoeffs;
 	FrameSize = source.lenses[lens].ROI.size();
 	CameraTransform = source.lenses[lens].LensPosition;
+	Latency = source.Latency;
 }
\ No newline at end of file
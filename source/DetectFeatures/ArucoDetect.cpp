@@ -2,6 +2,12 @@
 
 #include <iostream> // for standard I/O
 #include <math.h>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <tuple>
 
 #include <opencv2/core.hpp>
 #include <opencv2/calib3d.hpp>
@@ -12,17 +18,38 @@
 #include <Misc/math3d.hpp>
 
 #include <Misc/GlobalConf.hpp>
+#include <Cameras/UndistortionMaps.hpp>
+#include <Cameras/FrameChanges.hpp>
+#include <DetectFeatures/ArucoSharedThreshold.hpp>
+#include <DetectFeatures/CameraView.hpp>
+#include <ArucoPipeline/StaticObject.hpp>
 
 using namespace cv;
 using namespace std;
 
 const auto dict = aruco::getPredefinedDictionary(aruco::DICT_4X4_100);
-unique_ptr<aruco::ArucoDetector> GlobalDetector, POIDetector;
 
-void MakeDetectors()
+//Detectors and buffers of one thread, reused from frame to frame
+//Each worker of the segmented detection gets its own detectors instead of sharing one across tiles and cameras
+struct ArucoDetectorContext
 {
+	unique_ptr<aruco::ArucoDetector> GlobalDetector, POIDetector;
+	//Used by the thread that merges the segments, the workers only fill their own segment
+	ArucoThresholdedFrame Thresholded;
+	vector<vector<ArucoCornerArray>> SegmentCorners;
+	vector<vector<int>> SegmentIDs;
+	vector<int> Accumulations;
+	vector<Point2f> Means;
+};
+
+static thread_local ArucoDetectorContext DetectorContext;
+
+//Detectors of the calling thread, created the first time that thread detects
+ArucoDetectorContext& MakeDetectors()
+{
+	ArucoDetectorContext &Context = DetectorContext;
 	const int adaptiveThreshConstant = 20;
-	if (!GlobalDetector.get())
+	if (!Context.GlobalDetector.get())
 	{
 		auto params = aruco::DetectorParameters();
 		//enable corner refine only if aruco runs at native resolution
@@ -32,9 +59,9 @@ void MakeDetectors()
 
 		//params.minMarkerDistanceRate *= mulfac;
 		auto refparams = aruco::RefineParameters();
-		GlobalDetector = make_unique<aruco::ArucoDetector>(dict, params, refparams);
+		Context.GlobalDetector = make_unique<aruco::ArucoDetector>(dict, params, refparams);
 	}
-	if (!POIDetector.get())
+	if (!Context.POIDetector.get())
 	{
 		auto params = aruco::DetectorParameters();
 		//enable corner refine only if aruco runs at native resolution
@@ -44,8 +71,14 @@ void MakeDetectors()
 
 		//params.minMarkerDistanceRate *= mulfac;
 		auto refparams = aruco::RefineParameters();
-		POIDetector = make_unique<aruco::ArucoDetector>(dict, params, refparams);
+		Context.POIDetector = make_unique<aruco::ArucoDetector>(dict, params, refparams);
 	}
+	return Context;
+}
+
+static aruco::ArucoDetector& GetDetector(ArucoDetectorContext &Context, bool POI)
+{
+	return POI ? *Context.POIDetector : *Context.GlobalDetector;
 }
 
 UMat PreprocessArucoImage(UMat Source)
@@ -80,6 +113,27 @@ UMat PreprocessArucoImage(UMat Source)
 	}
 }
 
+int GetArucoDecodeScale()
+{
+	float reduction = GetReductionFactor();
+	int scale = 1;
+	while (scale < 8 && scale*2 <= reduction)
+	{
+		scale *= 2;
+	}
+	return scale;
+}
+
+//Full resolution image for aruco detection, prefers the luma decoded by the camera over the colour image
+const UMat& GetFullResolutionArucoImage(const CameraImageData &InData)
+{
+	if (!InData.GrayImage.empty() && InData.GrayScaleDenominator == 1)
+	{
+		return InData.GrayImage;
+	}
+	return InData.Image;
+}
+
 Point2f ComputeMean(const ArucoCornerArray &Points)
 {
 	Point2f mean(0,0);
@@ -91,29 +145,270 @@ Point2f ComputeMean(const ArucoCornerArray &Points)
 	return mean;
 }
 
-int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, const vector<Rect> &Segments, aruco::ArucoDetector* Detector)
+//Detections being merged, indexed by tag ID and by a cell around their mean
+//The cells are as large as the merge window, so a detection can only merge with the ones in the 3x3 cells around it
+class ArucoMergeHash
+{
+private:
+	float CellSize;
+	unordered_map<uint64_t, vector<size_t>> Cells;
+
+	Point GetCell(Point2f Mean) const
+	{
+		return Point(cvFloor(Mean.x / CellSize), cvFloor(Mean.y / CellSize));
+	}
+
+	static uint64_t GetKey(int ID, Point Cell)
+	{
+		return ((uint64_t)(uint16_t)ID << 48) | ((uint64_t)(Cell.x & 0xFFFFFF) << 24) | (uint64_t)(Cell.y & 0xFFFFFF);
+	}
+
+public:
+	ArucoMergeHash(float InCellSize, size_t ExpectedDetections)
+		:CellSize(InCellSize)
+	{
+		Cells.reserve(ExpectedDetections);
+	}
+
+	void Insert(int ID, Point2f Mean, size_t Index)
+	{
+		Cells[GetKey(ID, GetCell(Mean))].push_back(Index);
+	}
+
+	void Move(int ID, Point2f OldMean, Point2f NewMean, size_t Index)
+	{
+		Point OldCell = GetCell(OldMean), NewCell = GetCell(NewMean);
+		if (OldCell == NewCell)
+		{
+			return;
+		}
+		auto &indices = Cells[GetKey(ID, OldCell)];
+		indices.erase(find(indices.begin(), indices.end(), Index));
+		Insert(ID, NewMean, Index);
+	}
+
+	//First detection with that ID whose mean is within Threshold of Mean, like a linear search through Means would find
+	bool Find(int ID, Point2f Mean, const vector<Point2f> &Means, const Rect2f &Threshold, size_t &Found) const
+	{
+		Point Cell = GetCell(Mean);
+		bool HasFound = false;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				auto cell = Cells.find(GetKey(ID, Cell + Point(dx, dy)));
+				if (cell == Cells.end())
+				{
+					continue;
+				}
+				for (size_t index : cell->second)
+				{
+					if ((HasFound && index >= Found) || !(Mean - Means[index]).inside(Threshold))
+					{
+						continue;
+					}
+					Found = index;
+					HasFound = true;
+				}
+			}
+		}
+		return HasFound;
+	}
+};
+
+static vector<ArucoTile> MakeTiles(const vector<Rect> &Regions)
+{
+	vector<ArucoTile> Tiles(Regions.size());
+	for (size_t i = 0; i < Regions.size(); i++)
+	{
+		Tiles[i].Region = Regions[i];
+	}
+	return Tiles;
+}
+
+//Detect in a tile shrunk by its decimation, corners are in tile coordinates and refined at full resolution
+static void DetectArucoDecimated(const UMat &TileImage, int Decimation, aruco::ArucoDetector &Detector, 
+	vector<ArucoCornerArray> &Corners, vector<int> &IDs)
+{
+	Size decimatedsize(max(1, TileImage.cols / Decimation), max(1, TileImage.rows / Decimation));
+	UMat Decimated;
+	resize(TileImage, Decimated, decimatedsize, 0, 0, INTER_AREA);
+	Detector.detectMarkers(Decimated, Corners, IDs);
+	if (Corners.empty())
+	{
+		return;
+	}
+	Point2f scalefactor((float)TileImage.cols/decimatedsize.width, (float)TileImage.rows/decimatedsize.height);
+	for (auto &rect : Corners)
+	{
+		for (auto &point : rect)
+		{
+			//pixel centers of the area resize
+			point.x = (point.x + 0.5f) * scalefactor.x - 0.5f;
+			point.y = (point.y + 0.5f) * scalefactor.y - 0.5f;
+		}
+	}
+	UMat TileGray = PreprocessArucoImage(TileImage);
+	for (auto &rect : Corners)
+	{
+		cornerSubPix(TileGray, rect, Size(Decimation, Decimation), Size(-1,-1), TermCriteria(TermCriteria::COUNT | TermCriteria::EPS, 100, 0.01));
+	}
+}
+
+//Tiles cut to the part of the frame that sees the table, tiles that don't see it are dropped
+static vector<ArucoTile> ClipTilesToROI(const vector<ArucoTile> &Tiles, const CameraFeatureData &Data)
+{
+	if (Data.ROIMask.empty())
+	{
+		return Tiles;
+	}
+	vector<ArucoTile> Clipped;
+	Clipped.reserve(Tiles.size());
+	for (auto &tile : Tiles)
+	{
+		ArucoTile clipped = tile;
+		clipped.Region &= Data.ROIBounds;
+		if (clipped.Region.area() == 0 || countNonZero(Data.ROIMask(clipped.Region)) == 0)
+		{
+			continue;
+		}
+		Clipped.push_back(clipped);
+	}
+	return Clipped;
+}
+
+//Detections of a tile on the last frame it was detected on
+struct ArucoTileCache
+{
+	int FrameIndex;
+	vector<ArucoCornerArray> Corners;
+	vector<int> IDs;
+};
+
+//Tiles are detected again after that many frames even if nothing changed, so that a missed tag doesn't stay missed
+static const int MaxTileReuseFrames = 30;
+
+//Rect and decimation of a tile : the layout can change between calls, only the tiles laid out again exactly can be reused
+typedef tuple<int, int, int, int, int> ArucoTileKey;
+
+static ArucoTileKey GetTileKey(const ArucoTile &Tile)
 {
-	size_t NumSegments = Segments.size();
+	return {Tile.Region.x, Tile.Region.y, Tile.Region.width, Tile.Region.height, Tile.Decimation};
+}
+
+//Per camera, for segmented and POI detection. Entries are dropped once they are too old to be reused
+static map<pair<string, bool>, map<ArucoTileKey, ArucoTileCache>> ArucoTileCaches;
+static mutex ArucoTileCacheMutex;
+
+//CacheTiles : reuse and keep the detections of tiles where nothing changed, only worth it for tiles that are laid out the same way every frame
+static int DetectArucoInTiles(CameraImageData InData, CameraFeatureData *OutData, const vector<ArucoTile> &InTiles, bool POI, bool SharedThreshold, bool CacheTiles = true)
+{
+	const vector<ArucoTile> Tiles = ClipTilesToROI(InTiles, *OutData);
+	size_t NumSegments = Tiles.size();
 	if (NumSegments == 0)
 	{
 		return 0;
 	}
 	
-	vector<vector<ArucoCornerArray>> corners;
-	vector<vector<int>> ids;
-	corners.resize(NumSegments);
-	ids.resize(NumSegments);
-	parallel_for_(Range(0, NumSegments), 
-	[&InData, &Segments, &corners, &ids, NumSegments, Detector]
+	ArucoDetectorContext &Context = MakeDetectors();
+	//cleared but not shrunk, so that the detections of the previous frame left room for this one
+	vector<vector<ArucoCornerArray>> &corners = Context.SegmentCorners;
+	vector<vector<int>> &ids = Context.SegmentIDs;
+	if (corners.size() < NumSegments)
+	{
+		corners.resize(NumSegments);
+		ids.resize(NumSegments);
+	}
+	for (size_t poiidx = 0; poiidx < NumSegments; poiidx++)
+	{
+		corners[poiidx].clear();
+		ids[poiidx].clear();
+	}
+
+	//Tiles where nothing changed since they were last detected keep those detections
+	//Frame index the detections of each tile come from, -1 when the tile is detected on this frame (0 is a valid frame index)
+	vector<int> ReusedFrom(NumSegments, -1);
+	if (InData.Changes && CacheTiles)
+	{
+		const FrameChanges &Changes = *InData.Changes;
+		lock_guard<mutex> lock(ArucoTileCacheMutex);
+		const map<ArucoTileKey, ArucoTileCache> &Cache = ArucoTileCaches[{InData.CameraName, POI}];
+		for (size_t poiidx = 0; poiidx < NumSegments; poiidx++)
+		{
+			const ArucoTile &tile = Tiles[poiidx];
+			auto cached = Cache.find(GetTileKey(tile));
+			if (cached == Cache.end() || Changes.FrameIndex - cached->second.FrameIndex >= MaxTileReuseFrames
+				|| Changes.HasChangedSince(tile.Region, cached->second.FrameIndex))
+			{
+				continue;
+			}
+			corners[poiidx] = cached->second.Corners;
+			ids[poiidx] = cached->second.IDs;
+			ReusedFrom[poiidx] = cached->second.FrameIndex;
+		}
+	}
+	vector<int> ToDetect;
+	vector<Rect> Segments(NumSegments), DetectSegments;
+	ToDetect.reserve(NumSegments);
+	DetectSegments.reserve(NumSegments);
+	for (size_t i = 0; i < NumSegments; i++)
+	{
+		Segments[i] = Tiles[i].Region;
+		if (ReusedFrom[i] < 0)
+		{
+			ToDetect.push_back(i);
+			DetectSegments.push_back(Segments[i]);
+		}
+	}
+	
+	UMat SourceImage = GetFullResolutionArucoImage(InData);
+	if (SourceImage.empty() && InData.SparseUndistorted)
+	{
+		//only remap what the segments look at
+		SourceImage = InData.SparseUndistorted->GetRegions(DetectSegments);
+	}
+	if (SourceImage.empty())
+	{
+		return 0;
+	}
+	
+	//Threshold the frame once for all the segments, they overlap
+	UMat GrayImage;
+	Mat GrayMat;
+	ArucoThresholdedFrame &Thresholded = Context.Thresholded;
+	if (SharedThreshold && ToDetect.size() > 0)
+	{
+		GrayImage = PreprocessArucoImage(SourceImage);
+		GrayMat = GrayImage.getMat(ACCESS_READ);
+		ThresholdForAruco(GrayMat, DetectSegments, GetDetector(Context, POI).getDetectorParameters(), Thresholded, 
+			OutData->ROIMask.size() == GrayMat.size() ? OutData->ROIMask : Mat());
+	}
+	parallel_for_(Range(0, ToDetect.size()), 
+	[&SourceImage, &Tiles, &Segments, &ToDetect, &corners, &ids, POI, SharedThreshold, &Thresholded]
 	(Range InRange)
 	{
-		//Range InRange(0, numpois);
-		for (int poiidx = InRange.start; poiidx < InRange.end; poiidx++)
+		//detectors of the worker, not of the calling thread
+		aruco::ArucoDetector &Detector = GetDetector(MakeDetectors(), POI);
+		for (int detectidx = InRange.start; detectidx < InRange.end; detectidx++)
 		{
+			int poiidx = ToDetect[detectidx];
 			auto &thispoirect = Segments[poiidx];
 			auto &cornerslocal = corners[poiidx];
 			auto &idslocal = ids[poiidx];
-			Detector->detectMarkers(InData.Image(thispoirect), cornerslocal, idslocal);
+			if (SharedThreshold)
+			{
+				//already in frame coordinates
+				DetectArucoInRegion(Thresholded, thispoirect, Detector.getDictionary(), Detector.getDetectorParameters(), cornerslocal, idslocal);
+				continue;
+			}
+			if (Tiles[poiidx].Decimation > 1)
+			{
+				DetectArucoDecimated(SourceImage(thispoirect), Tiles[poiidx].Decimation, Detector, cornerslocal, idslocal);
+			}
+			else
+			{
+				Detector.detectMarkers(SourceImage(thispoirect), cornerslocal, idslocal);
+			}
 			for (auto &rect : cornerslocal)
 			{
 				for (auto &point : rect)
@@ -125,6 +420,29 @@ int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, con
 		}
 	});
 
+	if (InData.Changes && CacheTiles)
+	{
+		const int FrameIndex = InData.Changes->FrameIndex;
+		lock_guard<mutex> lock(ArucoTileCacheMutex);
+		//tiles of other layouts (segmented scan, geometric tiles) stay until they are too old
+		map<ArucoTileKey, ArucoTileCache> &Cache = ArucoTileCaches[{InData.CameraName, POI}];
+		for (size_t poiidx = 0; poiidx < NumSegments; poiidx++)
+		{
+			Cache[GetTileKey(Tiles[poiidx])] = {ReusedFrom[poiidx] >= 0 ? ReusedFrom[poiidx] : FrameIndex, corners[poiidx], ids[poiidx]};
+		}
+		for (auto it = Cache.begin(); it != Cache.end();)
+		{
+			if (FrameIndex - it->second.FrameIndex >= MaxTileReuseFrames || it->second.FrameIndex > FrameIndex)
+			{
+				it = Cache.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+
 	size_t NumDetectionsBefore = OutData->ArucoCorners.size();
 	size_t NumDetectionsThis = 0;
 	for (size_t poiidx = 0; poiidx < NumSegments; poiidx++)
@@ -132,18 +450,20 @@ int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, con
 		NumDetectionsThis += ids[poiidx].size();
 	}
 	size_t MaxDetectionsAfter = NumDetectionsThis + NumDetectionsBefore;
-	vector<int> accumulations;
-	vector<Point2f> means;
-	accumulations.resize(NumDetectionsBefore, 1);
+	vector<int> &accumulations = Context.Accumulations;
+	vector<Point2f> &means = Context.Means;
+	accumulations.assign(NumDetectionsBefore, 1);
 	accumulations.reserve(MaxDetectionsAfter);
-	means.resize(NumDetectionsBefore, Point2f(0,0));
+	means.assign(NumDetectionsBefore, Point2f(0,0));
 	means.reserve(MaxDetectionsAfter);
+	const float SameWindowSize = 4;
+	const Rect2f SameThreshold(-SameWindowSize/2,-SameWindowSize/2,SameWindowSize,SameWindowSize);
+	ArucoMergeHash Hash(SameWindowSize, MaxDetectionsAfter);
 	for (size_t i = 0; i < NumDetectionsBefore; i++)
 	{
 		means[i] = ComputeMean(OutData->ArucoCorners[i]);
+		Hash.Insert(OutData->ArucoIndices[i], means[i], i);
 	}
-	const float SameWindowSize = 4;
-	const Rect2f SameThreshold(-SameWindowSize/2,-SameWindowSize/2,SameWindowSize,SameWindowSize);
 	OutData->ArucoCorners.reserve(MaxDetectionsAfter);
 	OutData->ArucoIndices.reserve(MaxDetectionsAfter);
 	for (size_t poiidx = 0; poiidx < NumSegments; poiidx++)
@@ -157,52 +477,44 @@ int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, con
 		vector<int> &IDsLocal = ids[poiidx];
 		for (size_t PotentialIdx = 0; PotentialIdx < numdetslocal; PotentialIdx++)
 		{
-			bool found = false;
+			int ID = IDsLocal[PotentialIdx];
 			Point2f mean = ComputeMean(CornersLocal[PotentialIdx]);
-			for (size_t PresentIdx = 0; PresentIdx < OutData->ArucoCorners.size(); PresentIdx++)
+			size_t PresentIdx;
+			if (Hash.Find(ID, mean, means, SameThreshold, PresentIdx))
 			{
-				if (OutData->ArucoIndices[PresentIdx] != IDsLocal[PotentialIdx])
-				{
-					continue;
-				}
 				Point2f &meanother = means[PresentIdx];
-				Point2f diff = mean-meanother;
-				if (diff.inside(SameThreshold))
+				Point2f oldmean = meanother;
+				//mean the mean
+				meanother = (meanother*accumulations[PresentIdx] + mean) / (accumulations[PresentIdx]+1);
+				Hash.Move(ID, oldmean, meanother, PresentIdx);
+				for (size_t corneridx = 0; corneridx < OutData->ArucoCorners[PresentIdx].size(); corneridx++)
 				{
-					found = true;
-					//mean the mean
-					meanother = (meanother*accumulations[PresentIdx] + mean) / (accumulations[PresentIdx]+1);
-					for (size_t corneridx = 0; corneridx < OutData->ArucoCorners[PresentIdx].size(); corneridx++)
-					{
-						//mean the corner locations
-						OutData->ArucoCorners[PresentIdx][corneridx] = (OutData->ArucoCorners[PresentIdx][corneridx]*accumulations[PresentIdx] + CornersLocal[PotentialIdx][corneridx]) / (accumulations[PresentIdx]+1);
-					}
-					accumulations[PresentIdx]++;
-					//cout << "Merging aruco at " << mean << endl;
-					break;
+					//mean the corner locations
+					OutData->ArucoCorners[PresentIdx][corneridx] = (OutData->ArucoCorners[PresentIdx][corneridx]*accumulations[PresentIdx] + CornersLocal[PotentialIdx][corneridx]) / (accumulations[PresentIdx]+1);
 				}
-			}
-			if (found)
-			{
+				accumulations[PresentIdx]++;
+				//cout << "Merging aruco at " << mean << endl;
 				continue;
 			}
+			Hash.Insert(ID, mean, means.size());
 			means.push_back(mean);
-			OutData->ArucoIndices.push_back(IDsLocal[PotentialIdx]);
+			OutData->ArucoIndices.push_back(ID);
 			OutData->ArucoCorners.push_back(CornersLocal[PotentialIdx]);
 			accumulations.push_back(1);
 		}
 	}
 	OutData->ArucoCornersReprojected.resize(OutData->ArucoIndices.size());
 	copy(Segments.begin(), Segments.end(), back_inserter(OutData->ArucoSegments));
+	//the frame stays referenced until the next call otherwise
+	Thresholded.Gray.release();
 	return NumDetectionsThis;
 }
 
-int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, Size Segments)
+int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, Size Segments, bool SharedThreshold)
 {
 	assert(OutData != nullptr);
-	MakeDetectors();
 
-	Size framesize = InData.Image.size();
+	Size framesize = InData.GetFrameSize();
 	vector<Rect> ROIs;
 	ROIs.reserve(Segments.area());
 	Size2d cutsize(
@@ -233,41 +545,298 @@ int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, int
 			ROIs.emplace_back(xstart, ystart, xend - xstart, yend - ystart);
 		}
 	}
-	return DetectArucoSegmented(InData, OutData, ROIs, GlobalDetector.get());
+	return DetectArucoInTiles(InData, OutData, MakeTiles(ROIs), false, SharedThreshold);
+}
+
+int DetectArucoSegmented(CameraImageData InData, CameraFeatureData *OutData, const vector<ArucoTile> &Tiles, bool SharedThreshold)
+{
+	assert(OutData != nullptr);
+	return DetectArucoInTiles(InData, OutData, Tiles, false, SharedThreshold);
+}
+
+//Rects merged while they overlap or touch, as long as the merged rect is at most MaxWaste times the area of what it covers
+static void MergeRects(vector<Rect> &Rects, double MaxWaste = INFINITY)
+{
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < Rects.size() && !merged; i++)
+		{
+			for (size_t j = i+1; j < Rects.size(); j++)
+			{
+				//grown by one pixel so that adjacent rects merge too
+				Rect grown(Rects[i].x - 1, Rects[i].y - 1, Rects[i].width + 2, Rects[i].height + 2);
+				if ((grown & Rects[j]).area() == 0)
+				{
+					continue;
+				}
+				Rect merge = Rects[i] | Rects[j];
+				double covered = Rects[i].area() + Rects[j].area() - (Rects[i] & Rects[j]).area();
+				if (merge.area() > covered * MaxWaste)
+				{
+					continue;
+				}
+				Rects[i] = merge;
+				Rects.erase(Rects.begin() + j);
+				merged = true;
+				break;
+			}
+		}
+	}
+}
+
+//A tag seen in the previous frames of a camera, tracked in image space
+struct TrackedAruco
+{
+	int ID;
+	Point2f Center;
+	Point2f Velocity; //pixels per second
+	float Size; //largest side of the bounding box of the corners, pixels
+	chrono::steady_clock::time_point LastSeen;
+};
+
+struct ArucoTrackingState
+{
+	vector<TrackedAruco> Tags;
+	int FramesSinceFullScan = 0;
+	bool ForceFullScan = true;
+	Size FrameSize;
+};
+
+//Per camera name. Entries are never removed, there are only a handful of cameras
+static map<string, ArucoTrackingState> ArucoTrackingStates;
+static mutex ArucoTrackingMutex;
+
+//Windows where the tracked tags should be at Time, overlapping windows are merged so that no tag is detected twice
+static vector<Rect> GetTrackingWindows(const ArucoTrackingState &State, chrono::steady_clock::time_point Time)
+{
+	const Rect FrameRect(Point(0,0), State.FrameSize);
+	vector<Rect> Windows;
+	Windows.reserve(State.Tags.size());
+	for (auto &tag : State.Tags)
+	{
+		chrono::duration<float> dt = Time - tag.LastSeen;
+		Point2f motion = tag.Velocity * max(dt.count(), 0.f);
+		Point2f predicted = tag.Center + motion;
+		//room for the tag to rotate and tilt, and for the prediction to be off by half the motion
+		float halfextent = max(tag.Size * 1.5f + (float)norm(motion) * 0.5f + 16.f, 48.f);
+		Rect window(Point(predicted.x - halfextent, predicted.y - halfextent), Point(predicted.x + halfextent, predicted.y + halfextent));
+		window &= FrameRect;
+		if (window.area() > 0)
+		{
+			Windows.push_back(window);
+		}
+	}
+	MergeRects(Windows);
+	return Windows;
+}
+
+//Match the detections to the tracked tags to update their position and speed. Tracked tags that were not found are dropped
+//Returns true if a tracked tag was lost
+static bool UpdateTrackedArucos(ArucoTrackingState &State, const CameraFeatureData &Data, size_t FirstDetection, chrono::steady_clock::time_point Time)
+{
+	vector<TrackedAruco> Updated;
+	Updated.reserve(Data.ArucoIndices.size() - FirstDetection);
+	vector<bool> Matched(State.Tags.size(), false);
+	for (size_t i = FirstDetection; i < Data.ArucoIndices.size(); i++)
+	{
+		const ArucoCornerArray &corners = Data.ArucoCorners[i];
+		Rect bounds = boundingRect(corners);
+		TrackedAruco tag{Data.ArucoIndices[i], ComputeMean(corners), Point2f(0,0), (float)max(bounds.width, bounds.height), Time};
+		int closest = -1;
+		float closestdist = INFINITY;
+		for (size_t j = 0; j < State.Tags.size(); j++)
+		{
+			if (Matched[j] || State.Tags[j].ID != tag.ID)
+			{
+				continue;
+			}
+			float dist = norm(State.Tags[j].Center - tag.Center);
+			if (dist < closestdist)
+			{
+				closest = j;
+				closestdist = dist;
+			}
+		}
+		if (closest >= 0)
+		{
+			Matched[closest] = true;
+			const TrackedAruco &previous = State.Tags[closest];
+			chrono::duration<float> dt = Time - previous.LastSeen;
+			tag.Velocity = dt.count() > 0 ? (tag.Center - previous.Center) / dt.count() : previous.Velocity;
+		}
+		Updated.push_back(tag);
+	}
+	bool lost = find(Matched.begin(), Matched.end(), false) != Matched.end();
+	State.Tags = move(Updated);
+	return lost;
+}
+
+int DetectArucoTracked(CameraImageData InData, CameraFeatureData *OutData, int MaxArucoSize, Size Segments, int FullScanInterval, bool SharedThreshold,
+	const vector<ArucoTile> &FullScanTiles)
+{
+	assert(OutData != nullptr);
+	ArucoTrackingState* State;
+	{
+		lock_guard lock(ArucoTrackingMutex);
+		State = &ArucoTrackingStates[InData.CameraName];
+	}
+	Size framesize = InData.GetFrameSize();
+	if (State->FrameSize != framesize)
+	{
+		State->FrameSize = framesize;
+		State->Tags.clear();
+		State->ForceFullScan = true;
+	}
+	vector<Rect> Windows;
+	bool FullScan = State->ForceFullScan || State->Tags.empty() || State->FramesSinceFullScan + 1 >= FullScanInterval;
+	if (!FullScan)
+	{
+		Windows = GetTrackingWindows(*State, InData.GrabTime);
+		size_t WindowsArea = 0;
+		for (auto &window : Windows)
+		{
+			WindowsArea += window.area();
+		}
+		//when the tags cover half the frame, the grid is as fast and finds new tags too
+		FullScan = Windows.empty() || WindowsArea * 2 > (size_t)framesize.area();
+	}
+	size_t FirstDetection = OutData->ArucoIndices.size();
+	int NumDetections;
+	if (FullScan)
+	{
+		if (FullScanTiles.empty())
+		{
+			NumDetections = DetectArucoSegmented(InData, OutData, MaxArucoSize, Segments, SharedThreshold);
+		}
+		else
+		{
+			NumDetections = DetectArucoInTiles(InData, OutData, FullScanTiles, false, SharedThreshold);
+		}
+		State->FramesSinceFullScan = 0;
+	}
+	else
+	{
+		//the windows follow the tags and move every frame, they would never be found in the tile cache
+		NumDetections = DetectArucoInTiles(InData, OutData, MakeTiles(Windows), false, SharedThreshold, false);
+		State->FramesSinceFullScan++;
+	}
+	bool lost = UpdateTrackedArucos(*State, *OutData, FirstDetection, InData.GrabTime);
+	State->ForceFullScan = lost && !FullScan;
+	return NumDetections;
+}
+
+static CornerRefinementStats RefinementStats;
+static mutex RefinementStatsMutex;
+
+CornerRefinementStats GetCornerRefinementStats()
+{
+	lock_guard lock(RefinementStatsMutex);
+	return RefinementStats;
+}
+
+//the iteration count only bounds the corners that don't settle, and is the same as the per tag refinement it replaced
+//the iteration count only bounds the corners that don't settle, it stays at the 100 of the per tag refinement so results don't change
+static void RefineCornersBatched(const UMat &GrayFrame, vector<ArucoCornerArray> &Corners, Size Window)
+{
+	if (Corners.empty())
+	{
+		return;
+	}
+	const TermCriteria RefineCriteria(TermCriteria::COUNT | TermCriteria::EPS, 100, 0.01);
+	Mat GrayMat = GrayFrame.getMat(ACCESS_READ);
+	parallel_for_(Range(0, Corners.size()), [&](Range InRange)
+	{
+		CornerRefinementStats local;
+		for (int ArucoIdx = InRange.start; ArucoIdx < InRange.end; ArucoIdx++)
+		{
+			auto start = chrono::steady_clock::now();
+			cornerSubPix(GrayMat, Corners[ArucoIdx], Window, Size(-1,-1), RefineCriteria);
+			chrono::duration<double> cost = chrono::steady_clock::now() - start;
+			local.Tags++;
+			local.Seconds += cost.count();
+			local.MaxTagSeconds = max(local.MaxTagSeconds, cost.count());
+		}
+		lock_guard lock(RefinementStatsMutex);
+		RefinementStats.Tags += local.Tags;
+		RefinementStats.Seconds += local.Seconds;
+		RefinementStats.MaxTagSeconds = max(RefinementStats.MaxTagSeconds, local.MaxTagSeconds);
+	});
 }
 
 int DetectAruco(CameraImageData InData, CameraFeatureData *OutData)
 {
 	assert(OutData != nullptr);
-	MakeDetectors();
+	ArucoDetectorContext &Context = MakeDetectors();
 
-	Size framesize = InData.Image.size();
+	Size framesize = InData.GetFrameSize();
 	Size rescaled = GetArucoReduction();
-	UMat GrayFrame = PreprocessArucoImage(InData.Image);
+	//Full resolution gray, used for corner refinement. Not available if the camera only decoded a reduced luma
+	UMat GrayFrame;
+	if (!GetFullResolutionArucoImage(InData).empty())
+	{
+		GrayFrame = PreprocessArucoImage(GetFullResolutionArucoImage(InData));
+	}
+	else if (InData.SparseUndistorted)
+	{
+		//whole frame detection looks at everything
+		GrayFrame = PreprocessArucoImage(InData.SparseUndistorted->GetFull());
+	}
+	//Prefer the reduced luma from the camera, it's already close to the wanted size
+	UMat DetectionSource = InData.GrayImage.empty() ? GrayFrame : InData.GrayImage;
+	if (DetectionSource.empty())
+	{
+		return 0;
+	}
 
 	UMat ResizedFrame;
-	if (rescaled != framesize)
+	if (rescaled != DetectionSource.size())
 	{
-		assert(rescaled.height <= framesize.height && rescaled.width <= framesize.width);
-		resize(GrayFrame, ResizedFrame, rescaled);
+		assert(rescaled.height <= DetectionSource.rows && rescaled.width <= DetectionSource.cols);
+		resize(DetectionSource, ResizedFrame, rescaled);
 	}
 	else
 	{
-		ResizedFrame = GrayFrame;
+		ResizedFrame = DetectionSource;
 	}
 
 	vector<ArucoCornerArray> &corners = OutData->ArucoCorners;
 	vector<int> &IDs = OutData->ArucoIndices;
 
+	//only look at the part of the frame that sees the table
+	Rect DetectionROI(Point(0,0), ResizedFrame.size());
+	if (!OutData->ROIMask.empty())
+	{
+		Size2d roiscale((double)rescaled.width/framesize.width, (double)rescaled.height/framesize.height);
+		Rect bounds = OutData->ROIBounds;
+		Rect scaledbounds(Point(cvFloor(bounds.x*roiscale.width), cvFloor(bounds.y*roiscale.height)), 
+			Point(cvCeil(bounds.br().x*roiscale.width), cvCeil(bounds.br().y*roiscale.height)));
+		DetectionROI &= scaledbounds;
+		if (DetectionROI.area() == 0)
+		{
+			OutData->ArucoCornersReprojected.resize(corners.size(), {});
+			return 0;
+		}
+	}
+
 	try
 	{
-		GlobalDetector->detectMarkers(ResizedFrame, corners, IDs);
+		Context.GlobalDetector->detectMarkers(ResizedFrame(DetectionROI), corners, IDs);
 	}
 	catch(const std::exception& e)
 	{
 		std::cerr << e.what() << '\n';
 		return 0;
 	}
+	for (auto &rect : corners)
+	{
+		for (auto &point : rect)
+		{
+			point.x += DetectionROI.x;
+			point.y += DetectionROI.y;
+		}
+	}
 
 	if (framesize != rescaled)
 	{
@@ -285,10 +854,31 @@ int DetectAruco(CameraImageData InData, CameraFeatureData *OutData)
 			}
 		}
 
-		for (size_t ArucoIdx = 0; ArucoIdx < IDs.size(); ArucoIdx++)
+		if (!GrayFrame.empty())
 		{
-			Size window = Size(reductionFactors, reductionFactors);
-			cornerSubPix(GrayFrame, corners[ArucoIdx], window, Size(-1,-1), TermCriteria(TermCriteria::COUNT | TermCriteria::EPS, 100, 0.01));
+			RefineCornersBatched(GrayFrame, corners, Size(reductionFactors, reductionFactors));
+		}
+		else if (!InData.GrayImage.empty())
+		{
+			//Only the reduced luma was decoded : refine on it, with the window shrunk to match
+			//Less accurate than at full resolution, but the luma is never coarser than the detection
+			const float lumascale = InData.GrayScaleDenominator;
+			const int window = max(1, cvRound(reductionFactors / lumascale));
+			for (auto &tag : corners)
+			{
+				for (auto &corner : tag)
+				{
+					corner /= lumascale;
+				}
+			}
+			RefineCornersBatched(PreprocessArucoImage(InData.GrayImage), corners, Size(window, window));
+			for (auto &tag : corners)
+			{
+				for (auto &corner : tag)
+				{
+					corner *= lumascale;
+				}
+			}
 		}
 	}
 	OutData->ArucoCornersReprojected.resize(corners.size(), {});
@@ -302,23 +892,35 @@ vector<Rect> GetPOIRects(const vector<vector<Point3d>> &POIs, Size framesize, Af
 	{
 		return {};
 	}
+	//all the points in one projection
+	vector<Point3d> points;
+	for (auto &poi : POIs)
+	{
+		points.insert(points.end(), poi.begin(), poi.end());
+	}
+	if (points.empty())
+	{
+		return {};
+	}
+	auto InvCamTransform = CameraTransform.inv();
+	vector<Point2d> reprojected;
+	projectPoints(points, InvCamTransform.rvec(), InvCamTransform.translation(), CameraMatrix, distCoeffs, reprojected);
 	vector<Rect> poirects;
 	poirects.reserve(numpois);
-	auto InvCamTransform = CameraTransform.inv();
-	auto rvec = InvCamTransform.rvec();
-	auto tvec = InvCamTransform.translation();
+	size_t first = 0;
 	for (size_t poiidx = 0; poiidx < numpois; poiidx++)
 	{
-		vector<Point2d> reprojected;
-		projectPoints(POIs[poiidx], rvec, tvec, CameraMatrix, distCoeffs, reprojected);
+		size_t last = first + POIs[poiidx].size();
 		int top=framesize.height,bottom=0,left=framesize.width,right=0;
-		for (auto p : reprojected)
+		for (size_t i = first; i < last; i++)
 		{
+			auto &p = reprojected[i];
 			left = min<int>(left, p.x);
 			right = max<int>(right, p.x);
 			top = min<int>(top, p.y);
 			bottom = max<int>(bottom, p.y);
 		}
+		first = last;
 		left = max(0, left);
 		right = min(right, framesize.width);
 		top = max(0, top);
@@ -334,12 +936,209 @@ vector<Rect> GetPOIRects(const vector<vector<Point3d>> &POIs, Size framesize, Af
 	return poirects;
 }
 
-int DetectArucoPOI(CameraImageData InData, CameraFeatureData *OutData, const vector<vector<Point3d>> &POIs)
+struct POILayout
+{
+	CameraView View;
+	vector<vector<Point3d>> POIs;
+	vector<Rect> Rects;
+};
+
+//Per camera name, like the tile layouts
+static map<string, POILayout> POILayouts;
+static mutex POILayoutMutex;
+
+//Merged POI rects, cached until the pose, lens or POIs change
+static vector<Rect> GetMergedPOIRects(const string &CameraName, const vector<vector<Point3d>> &POIs, Size framesize, Affine3d CameraTransform, 
+	InputArray CameraMatrix, InputArray distCoeffs)
+{
+	//a merged rect may be a bit larger than its POIs, but one detection over it is cheaper than several over overlapping crops
+	const double MaxPOIWaste = 1.5;
+	Mat cameramatrix = CameraMatrix.getMat(), distcoeffs = distCoeffs.getMat();
+	lock_guard lock(POILayoutMutex);
+	POILayout &Layout = POILayouts[CameraName];
+	if (Layout.POIs != POIs || !Layout.View.Matches(framesize, CameraTransform, cameramatrix, distcoeffs))
+	{
+		Layout.View.Set(framesize, CameraTransform, cameramatrix, distcoeffs);
+		Layout.POIs = POIs;
+		Layout.Rects = GetPOIRects(POIs, framesize, CameraTransform, cameramatrix, distcoeffs);
+		MergeRects(Layout.Rects, MaxPOIWaste);
+	}
+	return Layout.Rects;
+}
+
+//Rays cast per side of a grid cell to find what it sees of the table
+static const int TileSamplesPerSide = 5;
+//Apparent side a tag keeps after decimation, 6 cells of 4 pixels for a 4x4 tag and its border
+static const float MinDecimatedTagPixels = 24;
+static const int MaxTileDecimation = 4;
+
+struct GeometricTileLayout
+{
+	CameraView View;
+	Size Segments;
+	double MinTagSize = 0, MaxTagSize = 0;
+	vector<ArucoTile> Tiles;
+};
+
+//Per camera name, like the tracking states
+static map<string, GeometricTileLayout> GeometricTileLayouts;
+static mutex GeometricTileMutex;
+
+static vector<ArucoTile> MakeGeometricArucoTiles(Size framesize, Affine3d CameraTransform, 
+	const Mat &CameraMatrix, const Mat &distCoeffs, double MinTagSize, double MaxTagSize, Size Segments)
+{
+	const int NumCells = Segments.area();
+	Size2d cellsize((double)framesize.width/Segments.width, (double)framesize.height/Segments.height);
+	//rays through a grid of pixels in each cell
+	vector<Point2d> pixels;
+	pixels.reserve(NumCells * TileSamplesPerSide * TileSamplesPerSide);
+	for (int cell = 0; cell < NumCells; cell++)
+	{
+		Point2d origin((cell % Segments.width) * cellsize.width, (cell / Segments.width) * cellsize.height);
+		for (int i = 0; i < TileSamplesPerSide * TileSamplesPerSide; i++)
+		{
+			Point2d offset((i % TileSamplesPerSide + 0.5) / TileSamplesPerSide, (i / TileSamplesPerSide + 0.5) / TileSamplesPerSide);
+			pixels.emplace_back(origin.x + offset.x * cellsize.width, origin.y + offset.y * cellsize.height);
+		}
+	}
+	vector<Point2d> rays;
+	undistortPoints(pixels, rays, CameraMatrix, distCoeffs);
+	//where the rays hit the table, and the corners of the largest tag lying flat there
+	const Matx33d rotation = CameraTransform.rotation();
+	const Vec3d position = CameraTransform.translation();
+	const double halftag = MaxTagSize/2;
+	const Rect2d TableArea = StaticObject::GetBoardArea();
+	vector<int> hitcells;
+	vector<Point3d> tagcorners;
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		Vec3d direction = rotation * Vec3d(rays[i].x, rays[i].y, 1);
+		//tags are on the table, from the table top to the top of the robots
+		for (double height : StaticObject::GetTableHeights())
+		{
+			if (abs(direction[2]) < 1e-9)
+			{
+				continue;
+			}
+			double distance = (height - position[2]) / direction[2];
+			if (distance <= 0)
+			{
+				continue;
+			}
+			Vec3d hit = position + direction * distance;
+			if (!TableArea.contains(Point2d(hit[0], hit[1])))
+			{
+				continue;
+			}
+			hitcells.push_back(i / (TileSamplesPerSide * TileSamplesPerSide));
+			tagcorners.emplace_back(hit[0] - halftag, hit[1] + halftag, height);
+			tagcorners.emplace_back(hit[0] + halftag, hit[1] + halftag, height);
+			tagcorners.emplace_back(hit[0] + halftag, hit[1] - halftag, height);
+			tagcorners.emplace_back(hit[0] - halftag, hit[1] - halftag, height);
+		}
+	}
+	if (hitcells.empty())
+	{
+		return {};
+	}
+	vector<Point2d> projected;
+	auto InvCamTransform = CameraTransform.inv();
+	projectPoints(tagcorners, InvCamTransform.rvec(), InvCamTransform.translation(), CameraMatrix, distCoeffs, projected);
+	//apparent side of the smallest tag and extent of the largest, per cell
+	vector<float> MinPixels(NumCells, INFINITY), MaxPixels(NumCells, 0);
+	const float SizeRatio = MinTagSize / MaxTagSize;
+	for (size_t i = 0; i < hitcells.size(); i++)
+	{
+		const Point2d* corners = &projected[i*4];
+		double minside = INFINITY;
+		for (int j = 0; j < 4; j++)
+		{
+			minside = min(minside, norm(corners[j] - corners[(j+1)%4]));
+		}
+		Rect2d bounds = boundingRect(vector<Point2f>(corners, corners+4));
+		int cell = hitcells[i];
+		MinPixels[cell] = min(MinPixels[cell], (float)minside * SizeRatio);
+		MaxPixels[cell] = max(MaxPixels[cell], (float)max(bounds.width, bounds.height));
+	}
+	const Rect FrameRect(Point(0,0), framesize);
+	vector<ArucoTile> Tiles;
+	//tiles are detected in parallel : only merge cells while there are more tiles left than workers
+	int SeenCells = count_if(MaxPixels.begin(), MaxPixels.end(), [](float pixels){return pixels > 0;});
+	int MergesLeft = max(0, SeenCells - getNumThreads());
+	for (int y = 0; y < Segments.height; y++)
+	{
+		//cells of this row, merged with their left neighbour when they have the same decimation
+		ArucoTile current;
+		float currentmax = 0;
+		for (int x = 0; x <= Segments.width; x++)
+		{
+			int cell = y * Segments.width + x;
+			bool seen = x < Segments.width && MaxPixels[cell] > 0;
+			int decimation = 1;
+			while (seen && decimation < MaxTileDecimation && MinPixels[cell] / (decimation*2) >= MinDecimatedTagPixels)
+			{
+				decimation *= 2;
+			}
+			if (current.Region.area() > 0 && (!seen || decimation != current.Decimation || MergesLeft == 0))
+			{
+				//overlap : a tag centered in the cell is fully inside the tile
+				int margin = cvCeil(currentmax/2) + 4;
+				Rect region(current.Region.tl() - Point(margin, margin), current.Region.br() + Point(margin, margin));
+				current.Region = region & FrameRect;
+				Tiles.push_back(current);
+				current = ArucoTile();
+				currentmax = 0;
+			}
+			if (!seen)
+			{
+				continue;
+			}
+			Rect cellrect(Point(cvFloor(x * cellsize.width), cvFloor(y * cellsize.height)), 
+				Point(cvFloor((x+1) * cellsize.width), cvFloor((y+1) * cellsize.height)));
+			if (current.Region.area() > 0)
+			{
+				current.Region |= cellrect;
+				MergesLeft--;
+			}
+			else
+			{
+				current.Region = cellrect;
+			}
+			current.Decimation = decimation;
+			currentmax = max(currentmax, MaxPixels[cell]);
+		}
+	}
+	return Tiles;
+}
+
+vector<ArucoTile> GetGeometricArucoTiles(const string &CameraName, Size framesize, Affine3d CameraTransform, 
+	InputArray CameraMatrix, InputArray distCoeffs, double MinTagSize, double MaxTagSize, Size Segments)
+{
+	if (Segments.area() <= 0 || MinTagSize <= 0 || MaxTagSize < MinTagSize)
+	{
+		return {};
+	}
+	Mat cameramatrix = CameraMatrix.getMat(), distcoeffs = distCoeffs.getMat();
+	lock_guard lock(GeometricTileMutex);
+	GeometricTileLayout &Layout = GeometricTileLayouts[CameraName];
+	if (Layout.Segments != Segments || Layout.MinTagSize != MinTagSize || Layout.MaxTagSize != MaxTagSize
+		|| !Layout.View.Matches(framesize, CameraTransform, cameramatrix, distcoeffs))
+	{
+		Layout.View.Set(framesize, CameraTransform, cameramatrix, distcoeffs);
+		Layout.Segments = Segments;
+		Layout.MinTagSize = MinTagSize;
+		Layout.MaxTagSize = MaxTagSize;
+		Layout.Tiles = MakeGeometricArucoTiles(framesize, CameraTransform, cameramatrix, distcoeffs, MinTagSize, MaxTagSize, Segments);
+	}
+	return Layout.Tiles;
+}
+
+int DetectArucoPOI(CameraImageData InData, CameraFeatureData *OutData, const vector<vector<Point3d>> &POIs, bool SharedThreshold)
 {
 	assert(OutData != nullptr);
-	MakeDetectors();
-	Size framesize = InData.Image.size();
-	vector<Rect> poirects = GetPOIRects(POIs, framesize, OutData->CameraTransform, InData.lenses[0].CameraMatrix, InData.lenses[0].distanceCoeffs); //TODO : Support stereo
+	Size framesize = InData.GetFrameSize();
+	vector<Rect> poirects = GetMergedPOIRects(InData.CameraName, POIs, framesize, OutData->CameraTransform, 
+		InData.lenses[0].CameraMatrix, InData.lenses[0].distanceCoeffs); //TODO : Support stereo
 
-	return DetectArucoSegmented(InData, OutData, poirects, POIDetector.get());
+	return DetectArucoInTiles(InData, OutData, MakeTiles(poirects), true, SharedThreshold);
 }
\ No newline at end of file
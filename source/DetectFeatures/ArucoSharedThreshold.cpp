@@ -0,0 +1,454 @@
+#include "DetectFeatures/ArucoSharedThreshold.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <math.h>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+//Rows thresholded together, each band builds its own integral image
+static const int ThresholdBandHeight = 64;
+
+//A quad found in the thresholds, before it is read
+struct ArucoCandidate
+{
+	ArucoCornerArray Corners;
+	size_t Perimeter; //pixels of the contour
+};
+
+//Buffers of one thread, kept between regions and frames so that detection doesn't allocate once they have grown
+struct ArucoScratch
+{
+	Mat Sum;
+	vector<vector<Point>> Contours;
+	vector<Point> Approx;
+	vector<ArucoCandidate> Candidates;
+	vector<Point2f> Centers;
+	Mat Warped, Bits;
+	//4x4 lookup of the last dictionary read by this thread, and the bytes it was looked up for
+	const struct Aruco4x4Lookup* Lookup = nullptr;
+	const uchar* LookupBytes = nullptr;
+};
+
+static thread_local ArucoScratch Scratch;
+
+//Markers with 4x4 bits fit a 16 bit code : bit 15 is the top left cell, bit 0 the bottom right, like the rows of Dictionary::bytesList
+//Every code is looked up in a table instead of comparing it to the 4 rotations of each marker
+struct Aruco4x4Lookup
+{
+	Mat BytesList; //dictionary the table was built from
+	//per code : ID << 16 | Rotation << 8 | wrong bits, for the marker with the fewest wrong bits
+	vector<uint32_t> Entries;
+};
+
+static constexpr int Aruco4x4Codes = 1 << 16;
+
+static constexpr array<uint8_t, 256> MakePopCountTable()
+{
+	array<uint8_t, 256> table{};
+	for (int i = 0; i < 256; i++)
+	{
+		table[i] = (i & 1) + table[i / 2];
+	}
+	return table;
+}
+
+static constexpr array<uint8_t, 256> PopCountTable = MakePopCountTable();
+
+static constexpr int PopCount16(uint32_t Code)
+{
+	return PopCountTable[Code & 0xFF] + PopCountTable[(Code >> 8) & 0xFF];
+}
+
+static_assert(PopCount16(0xFFFF) == 16 && PopCount16(0x8001) == 2);
+
+//Lookups are built once per dictionary, there is only a handful of dictionaries
+static vector<unique_ptr<Aruco4x4Lookup>> Aruco4x4Lookups;
+static mutex Aruco4x4LookupsMutex;
+
+static const Aruco4x4Lookup& GetAruco4x4Lookup(const aruco::Dictionary &Dictionary)
+{
+	if (Scratch.Lookup && Scratch.LookupBytes == Dictionary.bytesList.data && Scratch.Lookup->BytesList.size() == Dictionary.bytesList.size())
+	{
+		return *Scratch.Lookup;
+	}
+	const Mat &bytes = Dictionary.bytesList;
+	lock_guard lock(Aruco4x4LookupsMutex);
+	const Aruco4x4Lookup* found = nullptr;
+	for (auto &lookup : Aruco4x4Lookups)
+	{
+		if (lookup->BytesList.size() == bytes.size() && lookup->BytesList.type() == bytes.type() && norm(lookup->BytesList, bytes, NORM_INF) == 0)
+		{
+			found = lookup.get();
+			break;
+		}
+	}
+	if (!found)
+	{
+		auto lookup = make_unique<Aruco4x4Lookup>();
+		lookup->BytesList = bytes.clone();
+		//codes of the 4 rotations of each marker, see Dictionary::getByteListFromBits
+		vector<uint32_t> markercodes;
+		for (int id = 0; id < bytes.rows; id++)
+		{
+			const uchar* row = bytes.ptr<uchar>(id);
+			for (int rotation = 0; rotation < 4; rotation++)
+			{
+				markercodes.push_back((uint32_t)row[rotation] << 8 | row[4 + rotation]);
+			}
+		}
+		lookup->Entries.resize(Aruco4x4Codes);
+		for (uint32_t code = 0; code < Aruco4x4Codes; code++)
+		{
+			uint32_t best = UINT32_MAX;
+			for (size_t i = 0; i < markercodes.size(); i++)
+			{
+				uint32_t distance = PopCount16(code ^ markercodes[i]);
+				//lowest ID first on ties, like Dictionary::identify
+				if (distance < (best & 0xFF))
+				{
+					best = (uint32_t)(i/4) << 16 | (uint32_t)(i%4) << 8 | distance;
+				}
+			}
+			lookup->Entries[code] = best;
+		}
+		found = lookup.get();
+		Aruco4x4Lookups.push_back(move(lookup));
+	}
+	Scratch.Lookup = found;
+	Scratch.LookupBytes = bytes.data;
+	return *found;
+}
+
+//Same result as Dictionary::identify for a 4x4 dictionary, as long as no two markers are within the allowed wrong bits of each other
+static bool Identify4x4(const Mat &OnlyBits, const aruco::Dictionary &Dictionary, double ErrorCorrectionRate, int &ID, int &Rotation)
+{
+	uint32_t code = 0;
+	for (int y = 0; y < 4; y++)
+	{
+		const uchar* row = OnlyBits.ptr<uchar>(y);
+		for (int x = 0; x < 4; x++)
+		{
+			code = code << 1 | (row[x] & 1);
+		}
+	}
+	uint32_t entry = GetAruco4x4Lookup(Dictionary).Entries[code];
+	const int MaxCorrection = int(double(Dictionary.maxCorrectionBits) * ErrorCorrectionRate);
+	if ((int)(entry & 0xFF) > MaxCorrection)
+	{
+		return false;
+	}
+	ID = entry >> 16;
+	Rotation = (entry >> 8) & 0xFF;
+	return true;
+}
+
+//Set pixels in each cell of a thresholded warp, leaving out the margin of the cells
+//The warp is only a few pixels per cell (24x24 for 4x4 tags), too narrow for vector loads to pay off, so this is plain scalar code
+static void CountCellPixels(const Mat &Warped, int Cells, int CellSize, int CellMargin, Mat &Bits)
+{
+	const int InnerCell = CellSize - 2 * CellMargin;
+	const int Threshold = InnerCell * InnerCell / 2;
+	for (int cy = 0; cy < Cells; cy++)
+	{
+		uchar* bits = Bits.ptr<uchar>(cy);
+		for (int cx = 0; cx < Cells; cx++)
+		{
+			int count = 0;
+			for (int y = cy * CellSize + CellMargin; y < cy * CellSize + CellMargin + InnerCell; y++)
+			{
+				const uchar* src = Warped.ptr<uchar>(y) + cx * CellSize + CellMargin;
+				for (int x = 0; x < InnerCell; x++)
+				{
+					//the warp is 0 or 255, keep one bit per pixel
+					count += src[x] & 1;
+				}
+			}
+			bits[cx] = count > Threshold ? 1 : 0;
+		}
+	}
+}
+
+static vector<int> GetThresholdWindowSizes(const aruco::DetectorParameters &Params)
+{
+	vector<int> sizes;
+	int step = max(1, Params.adaptiveThreshWinSizeStep);
+	for (int size = max(3, Params.adaptiveThreshWinSizeMin); size <= Params.adaptiveThreshWinSizeMax; size += step)
+	{
+		//odd windows, like the aruco detector
+		sizes.push_back(size | 1);
+	}
+	return sizes;
+}
+
+//Merged column ranges of the regions that cross rows [y0, y1)
+static vector<Range> GetBandColumns(const vector<Rect> &Regions, int y0, int y1)
+{
+	vector<Range> columns;
+	for (auto &region : Regions)
+	{
+		if (region.y < y1 && region.y + region.height > y0)
+		{
+			columns.emplace_back(region.x, region.x + region.width);
+		}
+	}
+	sort(columns.begin(), columns.end(), [](const Range &a, const Range &b){return a.start < b.start;});
+	vector<Range> merged;
+	for (auto &range : columns)
+	{
+		if (!merged.empty() && range.start <= merged.back().end)
+		{
+			merged.back().end = max(merged.back().end, range.end);
+		}
+		else
+		{
+			merged.push_back(range);
+		}
+	}
+	return merged;
+}
+
+void ThresholdForAruco(const Mat &Gray, const vector<Rect> &Regions, const aruco::DetectorParameters &Params,
+	ArucoThresholdedFrame &Frame, const Mat &Mask)
+{
+	CV_Assert(Gray.type() == CV_8UC1);
+	CV_Assert(Mask.empty() || (Mask.type() == CV_8UC1 && Mask.size() == Gray.size()));
+	const vector<int> WindowSizes = GetThresholdWindowSizes(Params);
+	Frame.Gray = Gray;
+	Frame.Thresholds.resize(WindowSizes.size());
+	for (auto &threshold : Frame.Thresholds)
+	{
+		threshold.create(Gray.size(), CV_8UC1);
+	}
+	if (WindowSizes.empty())
+	{
+		return;
+	}
+	const Rect FrameRect(Point(0,0), Gray.size());
+	vector<Rect> ClippedRegions;
+	ClippedRegions.reserve(Regions.size());
+	for (auto &region : Regions)
+	{
+		Rect clipped = region & FrameRect;
+		if (clipped.area() > 0)
+		{
+			ClippedRegions.push_back(clipped);
+		}
+	}
+	const int halo = WindowSizes.back()/2;
+	//pixels darker than the mean of their window by at least idelta are set, like adaptiveThreshold with THRESH_BINARY_INV
+	const int idelta = cvFloor(Params.adaptiveThreshConstant);
+	const int NumBands = (Gray.rows + ThresholdBandHeight - 1) / ThresholdBandHeight;
+	parallel_for_(Range(0, NumBands), [&](Range InRange)
+	{
+		Mat &Sum = Scratch.Sum;
+		for (int band = InRange.start; band < InRange.end; band++)
+		{
+			int y0 = band * ThresholdBandHeight;
+			int y1 = min(y0 + ThresholdBandHeight, Gray.rows);
+			for (const Range &columns : GetBandColumns(ClippedRegions, y0, y1))
+			{
+				//integral of the band and of the halo the largest window needs
+				Rect IntegralRect(Point(max(columns.start - halo, 0), max(y0 - halo, 0)),
+					Point(min(columns.end + halo, Gray.cols), min(y1 + halo, Gray.rows)));
+				integral(Gray(IntegralRect), Sum, CV_32S);
+				for (size_t k = 0; k < WindowSizes.size(); k++)
+				{
+					const int half = WindowSizes[k]/2;
+					for (int y = y0; y < y1; y++)
+					{
+						//windows are clamped to the frame, where adaptiveThreshold replicates the border
+						const int wy0 = max(y - half, 0) - IntegralRect.y;
+						const int wy1 = min(y + half + 1, Gray.rows) - IntegralRect.y;
+						const int* top = Sum.ptr<int>(wy0);
+						const int* bottom = Sum.ptr<int>(wy1);
+						const uchar* src = Gray.ptr<uchar>(y);
+						const uchar* mask = Mask.empty() ? nullptr : Mask.ptr<uchar>(y);
+						uchar* dst = Frame.Thresholds[k].ptr<uchar>(y);
+						for (int x = columns.start; x < columns.end; x++)
+						{
+							const int wx0 = max(x - half, 0) - IntegralRect.x;
+							const int wx1 = min(x + half + 1, Gray.cols) - IntegralRect.x;
+							const int area = (wy1 - wy0) * (wx1 - wx0);
+							const int sum = bottom[wx1] - bottom[wx0] - top[wx1] + top[wx0];
+							//round(sum/area) >= src + idelta, without dividing
+							dst[x] = 2*sum >= (2*(src[x] + idelta) - 1) * area && (!mask || mask[x]) ? 255 : 0;
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+//Convex quads of the right size in a region of one threshold
+static void FindCandidates(const Mat &Threshold, Rect Region, const aruco::DetectorParameters &Params, vector<ArucoCandidate> &Candidates)
+{
+	const int MaxSize = max(Region.width, Region.height);
+	const size_t MinPerimeterPixels = Params.minMarkerPerimeterRate * MaxSize;
+	const size_t MaxPerimeterPixels = Params.maxMarkerPerimeterRate * MaxSize;
+	vector<vector<Point>> &contours = Scratch.Contours;
+	findContours(Threshold(Region), contours, RETR_LIST, CHAIN_APPROX_NONE, Region.tl());
+	vector<Point> &approx = Scratch.Approx;
+	for (auto &contour : contours)
+	{
+		if (contour.size() < MinPerimeterPixels || contour.size() > MaxPerimeterPixels)
+		{
+			continue;
+		}
+		approxPolyDP(contour, approx, contour.size() * Params.polygonalApproxAccuracyRate, true);
+		if (approx.size() != 4 || !isContourConvex(approx))
+		{
+			continue;
+		}
+		double MinSideSq = INFINITY;
+		for (int j = 0; j < 4; j++)
+		{
+			Point side = approx[j] - approx[(j+1)%4];
+			MinSideSq = min(MinSideSq, (double)side.dot(side));
+		}
+		double MinSide = contour.size() * Params.minCornerDistanceRate;
+		if (MinSideSq < MinSide * MinSide)
+		{
+			continue;
+		}
+		bool NearBorder = false;
+		for (auto &point : approx)
+		{
+			Point local = point - Region.tl();
+			NearBorder |= local.x < Params.minDistanceToBorder || local.y < Params.minDistanceToBorder
+				|| local.x > Region.width - 1 - Params.minDistanceToBorder || local.y > Region.height - 1 - Params.minDistanceToBorder;
+		}
+		if (NearBorder)
+		{
+			continue;
+		}
+		ArucoCandidate candidate;
+		candidate.Corners = {Point2f(approx[0]), Point2f(approx[1]), Point2f(approx[2]), Point2f(approx[3])};
+		candidate.Perimeter = contour.size();
+		//clockwise, like the aruco detector
+		Point2f d1 = candidate.Corners[1] - candidate.Corners[0];
+		Point2f d2 = candidate.Corners[2] - candidate.Corners[0];
+		if (d1.x * d2.y - d1.y * d2.x < 0)
+		{
+			swap(candidate.Corners[1], candidate.Corners[3]);
+		}
+		Candidates.push_back(move(candidate));
+	}
+}
+
+//Read the bits inside a candidate and look them up in the dictionary
+static bool ReadMarker(const Mat &Gray, const ArucoCornerArray &Corners, const aruco::Dictionary &Dictionary,
+	const aruco::DetectorParameters &Params, int &ID, int &Rotation)
+{
+	const int MarkerSize = Dictionary.markerSize;
+	const int Border = Params.markerBorderBits;
+	const int SizeWithBorders = MarkerSize + 2 * Border;
+	const int CellSize = Params.perspectiveRemovePixelPerCell;
+	const int CellMargin = Params.perspectiveRemoveIgnoredMarginPerCell * CellSize;
+	const int ResultSize = SizeWithBorders * CellSize;
+	const Point2f ResultCorners[4] = {Point2f(0,0), Point2f(ResultSize-1,0), Point2f(ResultSize-1,ResultSize-1), Point2f(0,ResultSize-1)};
+	Mat Transform = getPerspectiveTransform(Corners.data(), ResultCorners);
+	Mat &Warped = Scratch.Warped;
+	warpPerspective(Gray, Warped, Transform, Size(ResultSize, ResultSize), INTER_NEAREST);
+
+	Mat &Bits = Scratch.Bits;
+	Bits.create(SizeWithBorders, SizeWithBorders, CV_8UC1);
+	Bits.setTo(0);
+	Scalar mean, stddev;
+	meanStdDev(Warped(Rect(CellSize/2, CellSize/2, ResultSize - CellSize, ResultSize - CellSize)), mean, stddev);
+	if (stddev[0] < Params.minOtsuStdDev)
+	{
+		//uniform, Otsu would make up bits from noise
+		Bits.setTo(mean[0] > 127 ? 1 : 0);
+	}
+	else
+	{
+		threshold(Warped, Warped, 125, 255, THRESH_BINARY | THRESH_OTSU);
+		CountCellPixels(Warped, SizeWithBorders, CellSize, CellMargin, Bits);
+	}
+	//the border must be black
+	int BorderErrors = 0;
+	for (int y = 0; y < SizeWithBorders; y++)
+	{
+		for (int x = 0; x < SizeWithBorders; x++)
+		{
+			bool IsBorder = y < Border || y >= SizeWithBorders - Border || x < Border || x >= SizeWithBorders - Border;
+			if (IsBorder && Bits.at<uchar>(y, x) != 0)
+			{
+				BorderErrors++;
+			}
+		}
+	}
+	if (BorderErrors > MarkerSize * MarkerSize * Params.maxErroneousBitsInBorderRate)
+	{
+		return false;
+	}
+	if (MarkerSize == 4 && Dictionary.bytesList.cols == 2 && Dictionary.bytesList.type() == CV_8UC4)
+	{
+		return Identify4x4(Bits(Rect(Border, Border, MarkerSize, MarkerSize)), Dictionary, Params.errorCorrectionRate, ID, Rotation);
+	}
+	Mat OnlyBits = Bits(Rect(Border, Border, MarkerSize, MarkerSize)).clone();
+	return Dictionary.identify(OnlyBits, ID, Rotation, Params.errorCorrectionRate);
+}
+
+void DetectArucoInRegion(const ArucoThresholdedFrame &Frame, Rect Region, const aruco::Dictionary &Dictionary,
+	const aruco::DetectorParameters &Params, vector<ArucoCornerArray> &Corners, vector<int> &IDs)
+{
+	Region &= Rect(Point(0,0), Frame.Gray.size());
+	if (Region.area() == 0)
+	{
+		return;
+	}
+	//Corners may already hold detections of other regions, they are left untouched
+	const size_t FirstCorner = Corners.size();
+	vector<ArucoCandidate> &Candidates = Scratch.Candidates;
+	Candidates.clear();
+	for (auto &threshold : Frame.Thresholds)
+	{
+		FindCandidates(threshold, Region, Params, Candidates);
+	}
+	//Several window sizes find the same marker, and the inside of the border is a quad too :
+	//read the largest outlines first, and skip the candidates too close to a marker that was already read
+	sort(Candidates.begin(), Candidates.end(), [](const ArucoCandidate &a, const ArucoCandidate &b){return a.Perimeter > b.Perimeter;});
+	vector<Point2f> &Centers = Scratch.Centers;
+	Centers.clear();
+	for (auto &candidate : Candidates)
+	{
+		Point2f center = (candidate.Corners[0] + candidate.Corners[1] + candidate.Corners[2] + candidate.Corners[3]) / 4;
+		double MinDistance = candidate.Perimeter * Params.minMarkerDistanceRate;
+		bool TooClose = false;
+		for (auto &other : Centers)
+		{
+			TooClose |= norm(other - center) < MinDistance;
+		}
+		if (TooClose)
+		{
+			continue;
+		}
+		int ID, Rotation;
+		if (!ReadMarker(Frame.Gray, candidate.Corners, Dictionary, Params, ID, Rotation))
+		{
+			continue;
+		}
+		rotate(candidate.Corners.begin(), candidate.Corners.begin() + 4 - Rotation, candidate.Corners.end());
+		Centers.push_back(center);
+		Corners.push_back(candidate.Corners);
+		IDs.push_back(ID);
+	}
+	if (Params.cornerRefinementMethod == aruco::CORNER_REFINE_NONE)
+	{
+		return;
+	}
+	const Size RefineWindow(Params.cornerRefinementWinSize, Params.cornerRefinementWinSize);
+	const TermCriteria RefineCriteria(TermCriteria::MAX_ITER | TermCriteria::EPS, Params.cornerRefinementMaxIterations, Params.cornerRefinementMinAccuracy);
+	for (size_t i = FirstCorner; i < Corners.size(); i++)
+	{
+		cornerSubPix(Frame.Gray, Corners[i], RefineWindow, Size(-1,-1), RefineCriteria);
+	}
+}
@@ -0,0 +1,95 @@
+#include "DetectFeatures/BoardMask.hpp"
+
+#include <map>
+#include <mutex>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include <Misc/math3d.hpp>
+#include <ArucoPipeline/StaticObject.hpp>
+#include <DetectFeatures/CameraView.hpp>
+
+using namespace cv;
+using namespace std;
+
+//Room around the table, for robots and tags hanging over the edge
+static const double BoardMaskMargin = 0.1;
+//Points per side of the outline, so that the distortion bends the projected edges
+static const int BoardMaskEdgeSamples = 16;
+
+struct CachedBoardMask
+{
+	CameraView View;
+	BoardMask Mask;
+};
+
+//Per camera name, like the tracking states of aruco
+static map<string, CachedBoardMask> BoardMasks;
+static mutex BoardMasksMutex;
+
+static BoardMask MakeBoardMask(Size framesize, Affine3d CameraTransform, const Mat &CameraMatrix, const Mat &distCoeffs)
+{
+	Rect2d area = StaticObject::GetBoardArea();
+	area.x -= BoardMaskMargin;
+	area.y -= BoardMaskMargin;
+	area.width += BoardMaskMargin*2;
+	area.height += BoardMaskMargin*2;
+	auto InvCamTransform = CameraTransform.inv();
+	vector<Point3d> outline;
+	//the outline at the table top and at the top of the robots
+	for (double height : StaticObject::GetTableHeights())
+	{
+		const Point3d corners[4] = {
+			Point3d(area.x, area.y, height), Point3d(area.x + area.width, area.y, height), 
+			Point3d(area.x + area.width, area.y + area.height, height), Point3d(area.x, area.y + area.height, height)
+		};
+		for (int side = 0; side < 4; side++)
+		{
+			for (int i = 0; i < BoardMaskEdgeSamples; i++)
+			{
+				Point3d point = corners[side] + (corners[(side+1)%4] - corners[side]) * ((double)i / BoardMaskEdgeSamples);
+				if ((InvCamTransform * Vec3d(point))[2] <= 0)
+				{
+					//projection would wrap around, don't mask
+					return BoardMask();
+				}
+				outline.push_back(point);
+			}
+		}
+	}
+	vector<Point2d> projected;
+	projectPoints(outline, InvCamTransform.rvec(), InvCamTransform.translation(), CameraMatrix, distCoeffs, projected);
+	//the hull of both heights also covers what's seen between the table top and the robots' tops
+	vector<Point> points, hull;
+	points.reserve(projected.size());
+	for (auto &point : projected)
+	{
+		points.emplace_back(cvRound(point.x), cvRound(point.y));
+	}
+	convexHull(points, hull);
+	BoardMask mask;
+	mask.Mask = Mat::zeros(framesize, CV_8UC1);
+	fillConvexPoly(mask.Mask, hull, Scalar(255));
+	mask.Bounds = boundingRect(mask.Mask);
+	return mask;
+}
+
+BoardMask GetBoardMask(const string &CameraName, Size framesize, Affine3d CameraTransform, 
+	InputArray CameraMatrix, InputArray distCoeffs)
+{
+	Mat cameramatrix = CameraMatrix.getMat(), distcoeffs = distCoeffs.getMat();
+	lock_guard lock(BoardMasksMutex);
+	CachedBoardMask &Cached = BoardMasks[CameraName];
+	if (!Cached.View.Matches(framesize, CameraTransform, cameramatrix, distcoeffs))
+	{
+		Cached.View.Set(framesize, CameraTransform, cameramatrix, distcoeffs);
+		Cached.Mask = MakeBoardMask(framesize, CameraTransform, cameramatrix, distcoeffs);
+	}
+	return Cached.Mask;
+}
+
+Rect GetBoardBounds(const BoardMask &Mask, Size framesize)
+{
+	return Mask.empty() ? Rect(Point(0,0), framesize) : Mask.Bounds;
+}
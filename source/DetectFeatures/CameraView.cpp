@@ -0,0 +1,27 @@
+#include "DetectFeatures/CameraView.hpp"
+
+#include <Misc/math3d.hpp>
+
+using namespace cv;
+using namespace std;
+
+static bool IsSameMat(const Mat &A, const Mat &B)
+{
+	return A.size() == B.size() && (A.empty() || norm(A, B, NORM_INF) == 0);
+}
+
+bool CameraView::Matches(Size framesize, const Affine3d &InCameraTransform, const Mat &InCameraMatrix, const Mat &InDistCoeffs) const
+{
+	return Valid && FrameSize == framesize 
+		&& IsPoseClose(CameraTransform, InCameraTransform, MaxTranslation, MaxRotation)
+		&& IsSameMat(CameraMatrix, InCameraMatrix) && IsSameMat(DistCoeffs, InDistCoeffs);
+}
+
+void CameraView::Set(Size framesize, const Affine3d &InCameraTransform, const Mat &InCameraMatrix, const Mat &InDistCoeffs)
+{
+	FrameSize = framesize;
+	CameraTransform = InCameraTransform;
+	CameraMatrix = InCameraMatrix.clone();
+	DistCoeffs = InDistCoeffs.clone();
+	Valid = true;
+}
@@ -8,7 +8,8 @@ using namespace std;
 
 void DetectColor(const CameraImageData &InData, CameraFeatureData& OutData)
 {
-	(void) OutData;
+	//only count the pixels that see the table
+	Mat Mask = OutData.ROIMask.size() == InData.Image.size() ? OutData.ROIMask : Mat();
 	Mat HSVImage;
 	cvtColor(InData.Image, HSVImage, COLOR_BGR2HSV);
 	MatND Hist;
@@ -26,7 +27,7 @@ void DetectColor(const CameraImageData &InData, CameraFeatureData& OutData)
 	const float* ranges[] = { hranges, sranges };
 	// we compute the histogram from the 0-th and 1-st channels
 	static const int channels[] = {0, 1};
-	calcHist(&HSVImage, 1, channels, noArray(), Hist, 2, histSize, ranges, true, false);
+	calcHist(&HSVImage, 1, channels, Mask, Hist, 2, histSize, ranges, true, false);
 
 	double maxVal=0;
 	minMaxLoc(Hist, 0, &maxVal, 0, 0);
@@ -5,12 +5,15 @@
 #include <fstream>
 #include <chrono>
 #include <array>
+#include <algorithm>
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 #include <Misc/GlobalConf.hpp>
 #include <Misc/math3d.hpp>
+#include <Cameras/FrameChanges.hpp>
+#include <Transport/thread-rename.hpp>
 
 using namespace std;
 using namespace cv;
@@ -27,6 +30,15 @@ YoloDetect::YoloDetect(string inModelName, int inNumclasses)
 
 YoloDetect::~YoloDetect()
 {
+	{
+		unique_lock lock(AsyncMutex);
+		AsyncStopping = true;
+	}
+	JobAvailable.notify_all();
+	if (AsyncWorker)
+	{
+		AsyncWorker->join();
+	}
 }
 
 filesystem::path YoloDetect::GetNetworkPath(string extension) const
@@ -54,28 +66,123 @@ void YoloDetect::loadNet()
 		cout << "Backend " << backend.first << " is available with target " << backend.second << endl;
 	}
 	#endif
-	network = dnn::readNetFromDarknet(GetNetworkPath(".cfg"), GetNetworkPath(".weights"));
+	const YoloConfig &Config = GetYoloConfig();
+	//ONNX models first, the quantised one if wanted, then the darknet one
+	vector<filesystem::path> OnnxModels;
+	if (Config.PreferQuantized)
+	{
+		OnnxModels.push_back(GetNetworkPath("-int8.onnx"));
+	}
+	OnnxModels.push_back(GetNetworkPath(".onnx"));
+	for (auto &model : OnnxModels)
+	{
+		if (!filesystem::exists(model))
+		{
+			continue;
+		}
+		try
+		{
+			network = dnn::readNetFromONNX(model.string());
+		}
+		catch(const cv::Exception& e)
+		{
+			cerr << "WARNING : Failed to load yolo model " << model << " : " << e.what() << endl;
+			continue;
+		}
+		ModelFile = model.filename().string();
+		PixelCoordinates = true;
+		break;
+	}
+	if (network.empty())
+	{
+		network = dnn::readNetFromDarknet(GetNetworkPath(".cfg"), GetNetworkPath(".weights"));
+		ModelFile = GetNetworkPath(".cfg").filename().string();
+		PixelCoordinates = false;
+	}
+	selectBackend();
+	cout << "Yolo running " << GetBackendDescription() << endl;
 }
 
-void YoloDetect::Preprocess(const UMat& frame, Size inpSize, float scale, const Scalar& mean, bool swapRB)
+void YoloDetect::selectBackend()
+{
+	const YoloConfig &Config = GetYoloConfig();
+	auto available = dnn::getAvailableBackends();
+	auto IsAvailable = [&available](dnn::Backend Backend, dnn::Target Target)
+	{
+		return find(available.begin(), available.end(), make_pair(Backend, Target)) != available.end();
+	};
+	YoloBackend requested = (YoloBackend)Config.Backend;
+	dnn::Backend backend = dnn::DNN_BACKEND_OPENCV;
+	dnn::Target target = dnn::DNN_TARGET_CPU;
+	if (requested != YoloBackend::OpenCV && IsAvailable(dnn::DNN_BACKEND_INFERENCE_ENGINE, dnn::DNN_TARGET_CPU))
+	{
+		backend = dnn::DNN_BACKEND_INFERENCE_ENGINE;
+		if (Config.FP16 && IsAvailable(dnn::DNN_BACKEND_INFERENCE_ENGINE, dnn::DNN_TARGET_CPU_FP16))
+		{
+			target = dnn::DNN_TARGET_CPU_FP16;
+			BackendName = "OpenVINO CPU FP16";
+		}
+		else
+		{
+			//OpenVINO is still preferred over OpenCV's FP16 path : it picks its own CPU precision (bf16 where supported)
+			if (Config.FP16)
+			{
+				cerr << "WARNING : OpenVINO has no FP16 CPU target in this OpenCV build, yolo runs in OpenVINO's default precision" << endl;
+			}
+			BackendName = "OpenVINO CPU";
+		}
+	}
+	else
+	{
+		if (requested == YoloBackend::OpenVINO)
+		{
+			cerr << "WARNING : OpenCV was built without OpenVINO, yolo falls back to OpenCV's backend" << endl;
+		}
+		if (Config.FP16 && IsAvailable(dnn::DNN_BACKEND_OPENCV, dnn::DNN_TARGET_CPU_FP16))
+		{
+			target = dnn::DNN_TARGET_CPU_FP16;
+			BackendName = "OpenCV CPU FP16";
+		}
+		else
+		{
+			BackendName = "OpenCV CPU";
+		}
+	}
+	network.setPreferableBackend(backend);
+	network.setPreferableTarget(target);
+}
+
+string YoloDetect::GetBackendDescription() const
+{
+	return BackendName + " (" + ModelFile + ")";
+}
+
+void YoloDetect::Preprocess(const vector<UMat>& frames, Size inpSize, float scale, const Scalar& mean, bool swapRB)
 {
 	Mat blob;
-	// Create a 4D blob from a frame.
-	if (inpSize.width <= 0) inpSize.width = frame.cols;
-	if (inpSize.height <= 0) inpSize.height = frame.rows;
-	dnn::blobFromImage(frame, blob, 1.0, inpSize, Scalar(), swapRB, false);
+	// Create a 4D blob with one image per frame
+	if (inpSize.width <= 0) inpSize.width = frames[0].cols;
+	if (inpSize.height <= 0) inpSize.height = frames[0].rows;
+	dnn::blobFromImages(frames, blob, 1.0, inpSize, Scalar(), swapRB, false);
 	//cout << "Input has size " << blob.size << endl;
 	// Run a model.
 	network.setInput(blob, "", scale, mean);
 }
 
 
-vector<YoloDetect::Detection> YoloDetect::Postprocess(const vector<Mat> &outputBlobs, const vector<string> &layerNames, Rect window)
+vector<YoloDetect::Detection> YoloDetect::Postprocess(const vector<Mat> &outputBlobs, const vector<string> &layerNames, Rect window, int BatchIndex, int BatchSize)
 {
 	vector<Rect> boxes;
 	vector<float> scores;
 	vector<vector<float>> classes;
 	int numclasses = ClassNames.size();
+	//darknet gives boxes relative to the image, ONNX exports give them in pixels of the network input
+	float scalex = window.width, scaley = window.height;
+	if (PixelCoordinates)
+	{
+		scalex /= modelSize.width;
+		scaley /= modelSize.height;
+	}
 	for (size_t blobidx = 0; blobidx < outputBlobs.size(); blobidx++)
 	{
 		auto& blob = outputBlobs[blobidx];
@@ -86,6 +193,8 @@ vector<YoloDetect::Detection> YoloDetect::Postprocess(const vector<Mat> &outputB
 		{
 			numdet*=blob.size[i];
 		}
+		//the detections of each image of the batch follow each other
+		numdet /= BatchSize;
 		int numelem = blob.size[blob.size.dims()-1];
 		assert(numelem == numclasses +4 +1); //x, y, width, height, confidence, classes...
 		//cout << "Layer " << layername << " has " << numdet << " detections and " << numelem << " elements/detection" << endl;
@@ -96,13 +205,15 @@ vector<YoloDetect::Detection> YoloDetect::Postprocess(const vector<Mat> &outputB
 		int stride = blob.elemSize1() * numelem;
 		assert(blob.elemSize1() == sizeof(float));
 		//cout << "stride is " << stride << " bytes/detection" << endl;
-		for (const uint8_t* ptr = blob.data; ptr < blob.dataend; ptr+=stride)
+		const uint8_t* start = blob.data + (size_t)BatchIndex * numdet * stride;
+		const uint8_t* end = start + (size_t)numdet * stride;
+		for (const uint8_t* ptr = start; ptr < end; ptr+=stride)
 		{
 			auto recast = reinterpret_cast<const float*>(ptr);
-			float cx = recast[0]*window.width+window.x;
-			float cy = recast[1]*window.height+window.y;
-			float w = recast[2]*window.width;
-			float h = recast[3]*window.height;
+			float cx = recast[0]*scalex+window.x;
+			float cy = recast[1]*scaley+window.y;
+			float w = recast[2]*scalex;
+			float h = recast[3]*scaley;
 			boxes.emplace_back(cx-w/2, cy-h/2, w, h);
 			scores.emplace_back(recast[4]);
 			auto& classesloc = classes.emplace_back();
@@ -121,7 +232,6 @@ vector<YoloDetect::Detection> YoloDetect::Postprocess(const vector<Mat> &outputB
 	return OutDetections;
 }
 
-
 const string& YoloDetect::GetClassName(int index) const
 {
 	return ClassNames[index];
@@ -134,38 +244,179 @@ int YoloDetect::GetNumClasses() const
 
 int YoloDetect::Detect(CameraImageData InData, CameraFeatureData *OutData)
 {
-	Preprocess(InData.Image, modelSize, 1.0/255.0, 0, true);
+	return DetectBatch({InData}, {OutData});
+}
+
+int YoloDetect::DetectBatch(const vector<CameraImageData> &InData, const vector<CameraFeatureData*> &OutData)
+{
+	unique_lock NetworkLock(NetworkMutex);
+	//frames that need inference, and the part of each that is fed to the network
+	vector<size_t> Batch;
+	vector<Rect> Windows;
+	vector<UMat> Crops;
+	Batch.reserve(InData.size());
+	Windows.reserve(InData.size());
+	Crops.reserve(InData.size());
+	int numdetections = 0;
+	for (size_t imageidx = 0; imageidx < InData.size(); imageidx++)
+	{
+		const CameraImageData &image = InData[imageidx];
+		CameraFeatureData *features = OutData[imageidx];
+		features->YoloDetections.clear();
+		features->YoloGrabTime = image.GrabTime;
+		if (image.Image.empty())
+		{
+			continue;
+		}
+		//only look at the part of the frame that sees the table
+		Rect window(0,0,image.Image.cols, image.Image.rows);
+		if (!features->ROIMask.empty() && features->ROIMask.size() == image.Image.size())
+		{
+			window &= features->ROIBounds;
+			if (window.area() == 0)
+			{
+				continue;
+			}
+		}
+		if (image.Changes)
+		{
+			auto cached = LastDetections.find(image.CameraName);
+			if (cached != LastDetections.end() && cached->second.Window == window
+				&& image.Changes->FrameIndex - cached->second.FrameIndex < MaxReuseFrames
+				&& !image.Changes->HasChangedSince(window, cached->second.FrameIndex))
+			{
+				features->YoloDetections = cached->second.Detections;
+				numdetections += features->YoloDetections.size();
+				continue;
+			}
+		}
+		Batch.push_back(imageidx);
+		Windows.push_back(window);
+		Crops.push_back(image.Image(window));
+	}
+	if (Batch.empty())
+	{
+		return numdetections;
+	}
+	const size_t MaxBatchSize = max(1, GetYoloConfig().MaxBatchSize);
 	auto start = chrono::steady_clock::now();
 	vector<Mat> outputBlobs;
 	auto OutputNames = network.getUnconnectedOutLayersNames();
-	network.forward(outputBlobs, OutputNames);
-	auto stop = chrono::steady_clock::now();
-	auto detections = Postprocess(outputBlobs, OutputNames, Rect(0,0,InData.Image.cols, InData.Image.rows));
-	int numdetections = detections.size();
-	OutData->YoloDetections.clear();
-	OutData->YoloDetections.reserve(numdetections);
-	for (auto &det : detections)
+	for (size_t batchidx = 0; batchidx < Batch.size(); batchidx++)
 	{
-		int maxidx = 0;
-		for (size_t i = 1; i < det.Classes.size(); i++)
+		//run the network for the next chunk of the batch
+		const size_t ChunkStart = batchidx - batchidx % MaxBatchSize;
+		const size_t ChunkSize = min(MaxBatchSize, Batch.size() - ChunkStart);
+		if (batchidx == ChunkStart)
 		{
-			if (det.Classes[i] > det.Classes[maxidx])
+			vector<UMat> ChunkCrops(Crops.begin() + ChunkStart, Crops.begin() + ChunkStart + ChunkSize);
+			Preprocess(ChunkCrops, modelSize, 1.0/255.0, 0, true);
+			network.forward(outputBlobs, OutputNames);
+		}
+		const CameraImageData &image = InData[Batch[batchidx]];
+		CameraFeatureData *features = OutData[Batch[batchidx]];
+		const Rect &window = Windows[batchidx];
+		const bool Masked = !features->ROIMask.empty() && features->ROIMask.size() == image.Image.size();
+		auto detections = Postprocess(outputBlobs, OutputNames, window, batchidx - ChunkStart, ChunkSize);
+		features->YoloDetections.reserve(detections.size());
+		for (auto &det : detections)
+		{
+			Point center = (det.BoundingBox.tl() + det.BoundingBox.br())/2;
+			if (Masked && (!center.inside(window) || features->ROIMask.at<uchar>(center) == 0))
+			{
+				continue;
+			}
+			int maxidx = 0;
+			for (size_t i = 1; i < det.Classes.size(); i++)
 			{
-				maxidx = i;
+				if (det.Classes[i] > det.Classes[maxidx])
+				{
+					maxidx = i;
+				}
 			}
+			YoloDetection final_detection;
+			//cout << "Found " << maxidx << " at " << det.BoundingBox << " (Confidence " << det.Confidence << ")" << endl;
+			final_detection.Class = maxidx;
+			final_detection.Confidence = det.Confidence;
+			final_detection.Corners = det.BoundingBox;
+			features->YoloDetections.push_back(final_detection);
+		}
+		if (image.Changes)
+		{
+			LastDetections[image.CameraName] = {window, image.Changes->FrameIndex, features->YoloDetections};
 		}
-		YoloDetection final_detection;
-		//cout << "Found " << maxidx << " at " << det.BoundingBox << " (Confidence " << det.Confidence << ")" << endl;
-		final_detection.Class = maxidx;
-		final_detection.Confidence = det.Confidence;
-		final_detection.Corners = det.BoundingBox;
-		OutData->YoloDetections.push_back(final_detection);
+		numdetections += features->YoloDetections.size();
 	}
+	auto stop = chrono::steady_clock::now();
 	(void) start; (void) stop;
-	//cout << "Inference took " << chrono::duration<double>(stop-start).count() << "s and found " << numdetections << " objects" << endl;
+	//cout << "Inference of " << Batch.size() << " frames took " << chrono::duration<double>(stop-start).count() << "s and found " << numdetections << " objects" << endl;
 	return numdetections;
 }
 
+void YoloDetect::AsyncWorkerEntryPoint()
+{
+	SetThreadName("YoloWorker");
+	while (true)
+	{
+		//all the cameras that submitted a frame are run in one batch
+		map<string, AsyncJob> Jobs;
+		{
+			unique_lock lock(AsyncMutex);
+			JobAvailable.wait(lock, [this]{return AsyncStopping || !PendingJobs.empty();});
+			if (AsyncStopping)
+			{
+				return;
+			}
+			Jobs.swap(PendingJobs);
+		}
+		vector<CameraImageData> Images;
+		vector<CameraFeatureData> Features(Jobs.size());
+		vector<CameraFeatureData*> FeaturePointers;
+		Images.reserve(Jobs.size());
+		FeaturePointers.reserve(Jobs.size());
+		for (auto &job : Jobs)
+		{
+			CameraFeatureData &features = Features[Images.size()];
+			features.ROIMask = job.second.ROIMask;
+			features.ROIBounds = job.second.ROIBounds;
+			FeaturePointers.push_back(&features);
+			Images.push_back(move(job.second.Image));
+		}
+		DetectBatch(Images, FeaturePointers);
+		unique_lock lock(AsyncMutex);
+		for (size_t jobidx = 0; jobidx < Images.size(); jobidx++)
+		{
+			auto &result = AsyncResults[Images[jobidx].CameraName];
+			result.Detections = move(Features[jobidx].YoloDetections);
+			result.GrabTime = Images[jobidx].GrabTime;
+		}
+	}
+}
+
+int YoloDetect::DetectAsync(const CameraImageData &InData, CameraFeatureData *OutData)
+{
+	OutData->YoloDetections.clear();
+	OutData->YoloGrabTime = chrono::steady_clock::time_point();
+	unique_lock lock(AsyncMutex);
+	if (!AsyncWorker)
+	{
+		AsyncWorker = make_unique<thread>(&YoloDetect::AsyncWorkerEntryPoint, this);
+	}
+	AsyncJob &job = PendingJobs[InData.CameraName];
+	job.Image = InData;
+	job.ROIMask = OutData->ROIMask;
+	job.ROIBounds = OutData->ROIBounds;
+	auto result = AsyncResults.find(InData.CameraName);
+	if (result != AsyncResults.end() && InData.GrabTime - result->second.GrabTime < MaxAsyncResultAge)
+	{
+		OutData->YoloDetections = result->second.Detections;
+		OutData->YoloGrabTime = result->second.GrabTime;
+	}
+	lock.unlock();
+	JobAvailable.notify_one();
+	return OutData->YoloDetections.size();
+}
+
 static_assert(sizeof(Matx31d) == sizeof(Vec3d));
 vector<ObjectData> YoloDetect::Project(const CameraImageData &ImageData, const CameraFeatureData& FeatureData)
 {
@@ -177,6 +428,7 @@ vector<ObjectData> YoloDetect::Project(const CameraImageData &ImageData, const C
 	}
 	
 	objects.reserve(NumDetections);
+	const auto SeenTime = FeatureData.YoloGrabTime != chrono::steady_clock::time_point() ? FeatureData.YoloGrabTime : ObjectData::Now();
 
 	vector<Point2f> DistortedImagePoints, UndistortedImagePoints;
 	DistortedImagePoints.resize(NumDetections);
@@ -201,7 +453,7 @@ vector<ObjectData> YoloDetect::Project(const CameraImageData &ImageData, const C
 		ObjectType type = (ObjectType)((int)ObjectType::Fragile + Detection.Class);
 		const auto &name = GetClassName(Detection.Class);
 		ObjectData object(type, name, 
-			Affine3d(Vec3d::all(0), WorldPosition));
+			Affine3d(Vec3d::all(0), WorldPosition), SeenTime);
 		object.metadata["confidence"] = int(Detection.Confidence*100);
 		objects.emplace_back(object);
 		//imshow("Yolo ROI", ROI);
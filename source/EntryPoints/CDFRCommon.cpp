@@ -82,13 +82,24 @@ bool CDFRCommon::ImageToFeatureData(const CDFRCommon::Settings &Settings,
 	constexpr bool use_threads = false;
 	FeatData.Clear();
 	FeatData.CopyEssentials(ImData);
+	if (Settings.BoardMasking && cam && cam->GetLastSeenTick() != TrackedObject::TimePoint())
+	{
+		BoardMask mask = GetBoardMask(ImData.CameraName, ImData.GetFrameSize(), cam->GetLocation(), 
+			ImData.lenses[0].CameraMatrix, ImData.lenses[0].distanceCoeffs); //TODO : Support stereo
+		FeatData.ROIMask = mask.Mask;
+		FeatData.ROIBounds = mask.Bounds;
+	}
 	bool doYolo = Settings.YoloDetection && YoloDetector;
 	bool doAruco = Settings.ArucoDetection;
 	unique_ptr<thread> yoloThread;
 	unique_ptr<thread> arucoThread;
 	if (doYolo)
 	{
-		if (use_threads)
+		if (Settings.AsyncYolo)
+		{
+			YoloDetector->DetectAsync(ImData, &FeatData);
+		}
+		else if (use_threads)
 		{
 			yoloThread = make_unique<thread>(&YoloDetect::Detect, YoloDetector, 
 				ImData, &FeatData);
@@ -100,11 +111,31 @@ bool CDFRCommon::ImageToFeatureData(const CDFRCommon::Settings &Settings,
 	}
 	if (doAruco)
 	{
+		//Once the camera knows where it is, tiles follow the table instead of the fixed grid
+		vector<ArucoTile> Tiles;
+		double MinTagSize, MaxTagSize;
+		if (Settings.SegmentedDetection && Settings.GeometricTiles && cam && cam->GetLastSeenTick() != TrackedObject::TimePoint()
+			&& Tracker.GetArucoSizeRange(MinTagSize, MaxTagSize))
+		{
+			//finer than the fixed grid, so that decimation and skipping follow the table more closely
+			Tiles = GetGeometricArucoTiles(ImData.CameraName, ImData.GetFrameSize(), cam->GetLocation(), 
+				ImData.lenses[0].CameraMatrix, ImData.lenses[0].distanceCoeffs, MinTagSize, MaxTagSize, Size(8,6)); //TODO : Support stereo
+		}
 		if (use_threads)
 		{
-			if (Settings.SegmentedDetection)
+			if (Settings.SegmentedDetection && Settings.TrackedDetection)
 			{
-				arucoThread = make_unique<thread>(DetectArucoSegmented, ImData, &FeatData, 200, Size(4,3));
+				arucoThread = make_unique<thread>(DetectArucoTracked, ImData, &FeatData, 200, Size(4,3), Settings.FullScanInterval, Settings.SharedThreshold, Tiles);
+			}
+			else if (Settings.SegmentedDetection && !Tiles.empty())
+			{
+				arucoThread = make_unique<thread>(static_cast<int(*)(CameraImageData, CameraFeatureData*, const vector<ArucoTile>&, bool)>(DetectArucoSegmented), 
+					ImData, &FeatData, Tiles, Settings.SharedThreshold);
+			}
+			else if (Settings.SegmentedDetection)
+			{
+				arucoThread = make_unique<thread>(static_cast<int(*)(CameraImageData, CameraFeatureData*, int, Size, bool)>(DetectArucoSegmented), 
+					ImData, &FeatData, 200, Size(4,3), Settings.SharedThreshold);
 			}
 			else
 			{
@@ -113,9 +144,17 @@ bool CDFRCommon::ImageToFeatureData(const CDFRCommon::Settings &Settings,
 		}
 		else
 		{
-			if (Settings.SegmentedDetection)
+			if (Settings.SegmentedDetection && Settings.TrackedDetection)
+			{
+				DetectArucoTracked(ImData, &FeatData, 200, Size(4,3), Settings.FullScanInterval, Settings.SharedThreshold, Tiles);
+			}
+			else if (Settings.SegmentedDetection && !Tiles.empty())
+			{
+				DetectArucoSegmented(ImData, &FeatData, Tiles, Settings.SharedThreshold);
+			}
+			else if (Settings.SegmentedDetection)
 			{
-				DetectArucoSegmented(ImData, &FeatData, 200, Size(4,3));
+				DetectArucoSegmented(ImData, &FeatData, 200, Size(4,3), Settings.SharedThreshold);
 			}
 			else
 			{
@@ -157,7 +196,7 @@ bool CDFRCommon::ImageToFeatureData(const CDFRCommon::Settings &Settings,
 				arucoThread.reset();
 			}
 			const auto &POIs = Tracker.GetPointsOfInterest();
-			DetectArucoPOI(ImData, &FeatData, POIs);
+			DetectArucoPOI(ImData, &FeatData, POIs, Settings.SharedThreshold);
 		}
 	}
 	else
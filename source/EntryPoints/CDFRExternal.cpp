@@ -21,6 +21,9 @@
 #include <Cameras/CameraManagerV4L2.hpp>
 #include <Cameras/CameraManagerSimulation.hpp>
 #include <Cameras/VideoCaptureCamera.hpp>
+#include <Cameras/CameraV4L2Native.hpp>
+#include <Cameras/CameraRecordingReplay.hpp>
+#include <Cameras/FrameRecorder.hpp>
 
 #include <PostProcessing/YoloDeflicker.hpp>
 #include <PostProcessing/StockPlants.hpp>
@@ -127,13 +130,40 @@ CDFRTeam CDFRExternal::GetTeam()
 	return Team;
 }
 
-using ExternalProfType = ManualProfiler<false>;
+string CDFRExternal::GetYoloBackend() const
+{
+	lock_guard lock(YoloBackendMutex);
+	return YoloBackendDescription;
+}
+
+using ExternalProfType = ManualProfiler<true>;
+
+static void PrintCornerRefinementStats()
+{
+	CornerRefinementStats stats = GetCornerRefinementStats();
+	if (stats.Tags == 0)
+	{
+		return;
+	}
+	cout << "Corner refinement : " << stats.Tags << " tags, " << stats.Seconds * 1000 / stats.Tags << "ms/tag, slowest "
+		<< stats.MaxTagSeconds * 1000 << "ms" << endl;
+}
 
 void CDFRExternal::ThreadEntryPoint()
 {
 	SetThreadName("CDFRExternal runner");
+	//Playing a scenario once is a benchmark : profile it, don't sleep without clients, and print a summary at the end
+	const bool PlayOnce = GetScenario().size() && GetSimulationClock() != SimulationClock::Loop;
 	ExternalProfType prof("External Global Profile");
 	ExternalProfType ParallelProfiler("Parallel Cameras Detail");
+	prof.SetActive(PlayOnce);
+	ParallelProfiler.SetActive(PlayOnce);
+	int SimulatedTicks = 0, SimulatedFrames = 0;
+	chrono::steady_clock::time_point SimulationStart;
+	const chrono::seconds StatsPrintInterval(10);
+	chrono::steady_clock::time_point LastStatsPrint = chrono::steady_clock::now(), LastRecorderStatsPrint = LastStatsPrint;
+	uint64_t LastStatsAllocations = 0;
+	int LastStatsFrames = 0;
 	
 	if (GetScenario().size())
 	{
@@ -147,6 +177,10 @@ void CDFRExternal::ThreadEntryPoint()
 	}
 
 	YoloDetector = make_unique<YoloDetect>("cdfr", 4);
+	{
+		lock_guard lock(YoloBackendMutex);
+		YoloBackendDescription = YoloDetector->GetBackendDescription();
+	}
 
 	PostProcesses.emplace_back(make_unique<PostProcessYoloDeflicker>(this));
 	PostProcesses.emplace_back(make_unique<PostProcessStockPlants>(this));
@@ -172,12 +206,29 @@ void CDFRExternal::ThreadEntryPoint()
 	//track and untrack cameras dynamically
 	CameraMan->StartCamera = [](VideoCaptureCameraSettings settings) -> shared_ptr<Camera>
 	{
-		auto cam = make_shared<VideoCaptureCamera>(make_shared<VideoCaptureCameraSettings>(settings));
+		shared_ptr<Camera> cam;
+		if (settings.StartType == CameraStartType::V4L2_NATIVE)
+		{
+			cam = make_shared<CameraV4L2Native>(make_shared<VideoCaptureCameraSettings>(settings));
+		}
+		else if (settings.StartType == CameraStartType::RECORDING)
+		{
+			cam = make_shared<CameraRecordingReplay>(make_shared<VideoCaptureCameraSettings>(settings));
+		}
+		else
+		{
+			cam = make_shared<VideoCaptureCamera>(make_shared<VideoCaptureCameraSettings>(settings));
+		}
 		if(!cam->StartFeed())
 		{
 			cerr << "Failed to start feed @" << settings.DeviceInfo.device_description << endl;
 			return nullptr;
 		}
+		//Playback stays synchronous so that every frame of the video gets processed
+		if (settings.StartType != CameraStartType::PLAYBACK && settings.StartType != CameraStartType::RECORDING)
+		{
+			cam->StartCaptureThread();
+		}
 		return cam;
 	};
 	
@@ -227,8 +278,25 @@ void CDFRExternal::ThreadEntryPoint()
 		double deltaTime = fps.GetDeltaTime();
 		prof.EnterSection("CameraManager Tick");
 		Cameras = CameraMan->Tick();
+		if (PlayOnce && Cameras.size() == 0 && CameraMan->HasFinished())
+		{
+			prof.EnterSection("");
+			chrono::duration<double> SimulationDuration = chrono::steady_clock::now() - SimulationStart;
+			cout << "Simulation finished : " << SimulatedFrames << " frames in " << SimulatedTicks << " ticks, " 
+				<< SimulationDuration.count() << "s" << endl;
+			if (SimulatedTicks > 0)
+			{
+				cout << "Throughput : " << SimulatedFrames / SimulationDuration.count() << " frames/s, "
+					<< SimulatedTicks / SimulationDuration.count() << " ticks/s" << endl;
+			}
+			prof.PrintProfile(SimulatedTicks);
+			ParallelProfiler.PrintProfile(SimulatedFrames);
+			PrintCornerRefinementStats();
+			killed = true;
+			return;
+		}
 		bool HasNoData = Cameras.size() == 0;
-		bool IsUnseen = HasNoClients && !DirectImage && !OpenGLBoard;
+		bool IsUnseen = HasNoClients && !DirectImage && !OpenGLBoard && !PlayOnce;
 		if (HasNoData || IsUnseen)
 		{
 			prof.EnterSection("Sleep");
@@ -293,13 +361,59 @@ void CDFRExternal::ThreadEntryPoint()
 		if (RecordThisTick)
 		{
 			LastRecordTime = ObjectData::Clock::now();
+			if (!Recorder)
+			{
+				filesystem::path ContainerPath;
+				if (GetRecordingConfig().Container)
+				{
+					ContainerPath = RecordRootPath;
+					ContainerPath += ".cyrec";
+				}
+				Recorder = make_unique<FrameRecorder>(ContainerPath);
+			}
 		}
 		
 		
 		
 		
+		//Only decode colour when something will look at it, aruco only needs the luma
+		//Recording writes the compressed frame when the camera has one, and decodes it itself otherwise
+		bool NeedColor = CDFRCommon::ExternalSettings.YoloDetection || DirectImage;
+		for (auto &i : PostProcesses)
+		{
+			NeedColor |= i->NeedsColorImage(Cameras.size());
+		}
+		//Segmented aruco only looks at parts of the frame, undistort those on demand when nothing else needs the full undistorted frame
+		bool SparseUndistort = !CDFRCommon::ExternalSettings.DistortedDetection && CDFRCommon::ExternalSettings.SparseUndistortion
+			&& CDFRCommon::ExternalSettings.SegmentedDetection && !NeedColor;
+		NeedColor |= !CDFRCommon::ExternalSettings.DistortedDetection && !SparseUndistort;
+		//segmented detection runs at full resolution
+		//Whole frame detection refines its corners on the full resolution luma unless told to trade that accuracy for decode speed
+		int LumaScale = CDFRCommon::ExternalSettings.SegmentedDetection || CDFRCommon::ExternalSettings.FullResolutionRefinement ? 1 : GetArucoDecodeScale();
+		for (size_t i = 0; i < Cameras.size(); i++)
+		{
+			Cameras[i]->SetDecodeMode(!NeedColor, LumaScale);
+			Cameras[i]->SetKeepCompressed(CDFRCommon::ExternalSettings.record);
+		}
+
 		prof.EnterSection("Camera Gather Frames");
-		auto GrabTick = chrono::steady_clock::now();
+		//Threaded cameras decode on their own : cameras that have a new frame are processed, the others are skipped this tick
+		//Only wait when none of them has one, and not for longer than the config says
+		{
+			MailboxSignal &NewFrameSignal = Camera::GetNewFrameSignal();
+			uint64_t SeenFrames = NewFrameSignal.GetCount();
+			bool AnyReady = Cameras.empty();
+			for (size_t i = 0; i < Cameras.size() && !AnyReady; i++)
+			{
+				AnyReady = !Cameras[i]->IsCaptureThreaded() || Cameras[i]->HasNewFrame();
+			}
+			if (!AnyReady)
+			{
+				NewFrameSignal.WaitFor(SeenFrames, chrono::milliseconds(GetCaptureConfig().FrameWaitMs));
+			}
+		}
+		//Exposure time of the newest frame of this tick, so that object ages include the camera latency
+		TrackedObject::TimePoint GrabTick;
 		
 		for (size_t i = 0; i < Cameras.size(); i++)
 		{
@@ -309,10 +423,25 @@ void CDFRExternal::ThreadEntryPoint()
 		int NumCams = Cameras.size();
 		vector<CameraImageData> &ImageDataLocal = ImageData[BufferIndex];
 		vector<CameraFeatureData> &FeatureDataLocal = FeatureData[BufferIndex];
+		//Last tick's data, carried forward for the cameras that have no new frame this tick
+		const vector<CameraImageData> &LastImageData = ImageData[GetReadBufferIndex()];
+		const vector<CameraFeatureData> &LastFeatureData = FeatureData[GetReadBufferIndex()];
 		vector<ExternalProfType> ParallelProfilers;
 		ImageDataLocal.resize(NumCams);
 		FeatureDataLocal.resize(NumCams);
 		ParallelProfilers.resize(NumCams);
+		for (auto &pprof : ParallelProfilers)
+		{
+			pprof.SetActive(PlayOnce);
+		}
+		if (NumCams > 0)
+		{
+			if (SimulatedTicks == 0)
+			{
+				SimulationStart = chrono::steady_clock::now();
+			}
+			SimulatedTicks++;
+		}
 		prof.EnterSection("Parallel Cameras");
 
 		//grab frames
@@ -323,6 +452,9 @@ void CDFRExternal::ThreadEntryPoint()
 		/*parallel_for_(Range(0, Cameras.size()), 
 		[&Cameras, &FeatureDataLocal, &CamerasWithPosition, TrackerToUse, GrabTick, &ParallelProfilers]
 		(Range InRange)*/
+		//Without the asynchronous lane, yolo runs once for all the cameras after the loop
+		const bool BatchYolo = CDFRCommon::ExternalSettings.YoloDetection && !CDFRCommon::ExternalSettings.AsyncYolo;
+		vector<size_t> YoloCameras;
 		{
 			Range InRange(0, Cameras.size());
 			for (int i = InRange.start; i < InRange.end; i++)
@@ -333,10 +465,39 @@ void CDFRExternal::ThreadEntryPoint()
 				thisprof.EnterSection("CameraRead");
 				if(!cam->Read())
 				{
-					FeatData.Clear();
+					//No new frame : keep the camera in the solve with its last frame and features, they keep that frame's GrabTime
+					//If there is none (first tick, cameras changed), the camera is left out of both the images and the features
+					CameraImageData &ImData = ImageDataLocal[i];
+					if (i < (int)LastImageData.size() && LastImageData[i].Valid && LastImageData[i].CameraName == cam->GetName())
+					{
+						ImData = LastImageData[i];
+						FeatData = LastFeatureData[i];
+						GrabTick = max(GrabTick, ImData.GrabTime);
+					}
+					else
+					{
+						ImData = CameraImageData();
+						FeatData.Clear();
+					}
 					continue;
 				}
-				if (!CDFRCommon::ExternalSettings.DistortedDetection)
+				SimulatedFrames++;
+				if (NeedColor)
+				{
+					thisprof.EnterSection("CameraDecodeColor");
+					cam->DecodeColor();
+				}
+				if (CDFRCommon::ExternalSettings.ChangeGating)
+				{
+					thisprof.EnterSection("CameraFrameChanges");
+					cam->UpdateFrameChanges();
+				}
+				if (SparseUndistort)
+				{
+					thisprof.EnterSection("CameraUndistortSparse");
+					cam->UndistortSparse();
+				}
+				else if (!CDFRCommon::ExternalSettings.DistortedDetection)
 				{
 					thisprof.EnterSection("CameraUndistort");
 					cam->Undistort();
@@ -356,12 +517,18 @@ void CDFRExternal::ThreadEntryPoint()
 					//imwrite("noised.jpg", ImData.Image);
 					break;
 				}
-				CDFRCommon::ImageToFeatureData(CDFRCommon::ExternalSettings, cam, ImData, FeatData, *TrackerToUse, GrabTick, YoloDetector.get());
+				GrabTick = max(GrabTick, ImData.GrabTime);
+				CDFRCommon::ImageToFeatureData(CDFRCommon::ExternalSettings, cam, ImData, FeatData, *TrackerToUse, ImData.GrabTime, 
+					BatchYolo ? nullptr : YoloDetector.get());
+				if (BatchYolo)
+				{
+					YoloCameras.push_back(i);
+				}
 
 				if (RecordThisTick)
 				{
 					cout << "\aRecording image " << TimeToStr() << endl;
-					cam->Record(RecordRootPath, RecordImageIndex);
+					cam->Record(RecordRootPath, RecordImageIndex, Recorder.get());
 				}
 				
 				thisprof.EnterSection("");
@@ -374,6 +541,31 @@ void CDFRExternal::ThreadEntryPoint()
 			ParallelProfiler += pprof;
 		}
 
+		if (YoloCameras.size() > 0)
+		{
+			prof.EnterSection("Yolo");
+			vector<CameraImageData> YoloImages;
+			vector<CameraFeatureData*> YoloFeatures;
+			YoloImages.reserve(YoloCameras.size());
+			YoloFeatures.reserve(YoloCameras.size());
+			for (size_t camidx : YoloCameras)
+			{
+				YoloImages.push_back(ImageDataLocal[camidx]);
+				YoloFeatures.push_back(&FeatureDataLocal[camidx]);
+			}
+			YoloDetector->DetectBatch(YoloImages, YoloFeatures);
+		}
+
+		if (GrabTick == TrackedObject::TimePoint())
+		{
+			GrabTick = ObjectData::Now();
+		}
+		else if (PlayOnce)
+		{
+			//simulated frames are stamped from the video, not from when they're processed : ages follow the newest frame
+			ObjectData::SetSimulatedNow(GrabTick);
+		}
+
 		prof.EnterSection("3D Solve");
 		TrackerToUse->SolveLocationsPerObject(FeatureDataLocal, GrabTick);
 		vector<ObjectData> &ObjDataLocal = ObjData[BufferIndex]; 
@@ -465,6 +657,35 @@ void CDFRExternal::ThreadEntryPoint()
 			prof.PrintProfile();
 			ParallelProfiler.PrintProfile();
 		}
+		//Pipeline stats are printed in live runs too, the profiler is only active when benchmarking
+		if (Cameras.size() > 0 && chrono::steady_clock::now() - LastStatsPrint >= StatsPrintInterval)
+		{
+			LastStatsPrint = chrono::steady_clock::now();
+			PrintCornerRefinementStats();
+			//allocations should stop growing once the pipeline is full : the per frame rate should then read 0
+			uint64_t PoolAllocations = 0;
+			for (auto cam : Cameras)
+			{
+				auto PoolStats = cam->GetFramePoolStats();
+				PoolAllocations += PoolStats.Allocations;
+				cout << "Frame pool of " << cam->GetName() << " : " << PoolStats.Buffers << " buffers, "
+					<< PoolStats.Allocations << " allocations, " << PoolStats.Reuses << " reuses" << endl;
+			}
+			int StatsFrames = SimulatedFrames - LastStatsFrames;
+			if (StatsFrames > 0 && PoolAllocations >= LastStatsAllocations)
+			{
+				cout << "Frame pools : " << (double)(PoolAllocations - LastStatsAllocations) / StatsFrames 
+					<< " allocations per frame over the last " << StatsFrames << " frames" << endl;
+			}
+			LastStatsAllocations = PoolAllocations;
+			LastStatsFrames = SimulatedFrames;
+		}
+		//Recorder stats don't depend on the cameras, the recorder also prints them when it's destroyed
+		if (Recorder && chrono::steady_clock::now() - LastRecorderStatsPrint >= StatsPrintInterval)
+		{
+			LastRecorderStatsPrint = chrono::steady_clock::now();
+			Recorder->PrintStats();
+		}
 	}
 }
 
@@ -0,0 +1,71 @@
+#include "Misc/FramePool.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool FramePool::IsFree(const UMat &Buffer)
+{
+	if (!Buffer.u)
+	{
+		return false;
+	}
+	//urefcount counts the UMat headers, refcount the Mats mapped from it
+	//Other threads release their references with CV_XADD, so read them the same way : adding 0 is an atomic load,
+	//and its ordering makes their last writes to the buffer visible before it's handed out again
+	//Only the pool can add a reference to a free buffer, and it holds Mutex, so a free buffer stays free
+	int UMatRefs = CV_XADD(&Buffer.u->urefcount, 0);
+	int MatRefs = CV_XADD(&Buffer.u->refcount, 0);
+	return UMatRefs == 1 && MatRefs == 0;
+}
+
+UMat FramePool::Get(Size Size, int Type)
+{
+	lock_guard lock(Mutex);
+	size_t SameFormat = 0;
+	for (auto &buffer : Buffers)
+	{
+		if (buffer.size() != Size || buffer.type() != Type)
+		{
+			continue;
+		}
+		SameFormat++;
+		if (IsFree(buffer))
+		{
+			Reuses++;
+			return buffer;
+		}
+	}
+	UMat buffer(Size, Type);
+	Allocations++;
+	if (SameFormat < MaxBuffersPerFormat)
+	{
+		Buffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+void FramePool::Clear()
+{
+	lock_guard lock(Mutex);
+	for (size_t i = 0; i < Buffers.size();)
+	{
+		if (IsFree(Buffers[i]))
+		{
+			Buffers.erase(Buffers.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+FramePool::Stats FramePool::GetStats() const
+{
+	lock_guard lock(Mutex);
+	Stats stats;
+	stats.Allocations = Allocations;
+	stats.Reuses = Reuses;
+	stats.Buffers = Buffers.size();
+	return stats;
+}
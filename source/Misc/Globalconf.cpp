@@ -13,6 +13,8 @@ using namespace cv;
 
 bool ScreenCapture = false;
 string Scenario = "";
+int SimulationClockMode = (int)SimulationClock::Loop;
+int RawFrameCacheSetting = (int)RawFrameCacheMode::Off;
 aruco::ArucoDetector ArucoDet;
 bool HasDetector = false;
 vector<UMat> MarkerImages;
@@ -25,7 +27,9 @@ bool RecordVideo = false;
 KeepAliveSettings KeepAliveConfig = {30, 3*60}; //Delay between messages, Delay before kick when no response
 
 //Default values
-CaptureConfig CaptureCfg = {(int)CameraStartType::ANY, Size(3840,3032), 1.f, 30, 1, ""};
+CaptureConfig CaptureCfg = {(int)CameraStartType::ANY, Size(3840,3032), 1.f, 30, 1, "", 4, 10};
+RecordingConfig RecordingCfg = {16, 2, (int)RecordDropPolicy::DropNewest, false};
+YoloConfig YoloCfg = {(int)YoloBackend::Auto, true, false, 8};
 vector<InternalCameraConfig> CamerasInternal;
 CalibrationConfig CamCalConf = {40, Size(6,4), 0.5, 1.5, Size2d(4.96, 3.72)};
 
@@ -73,6 +77,8 @@ void InitConfig()
 
 	CopyOrDefaultRef(configobj, "Scenario", Scenario);
 	CopyOrDefaultRef(configobj, "ScreenCapture", ScreenCapture);
+	CopyOrDefaultRef(configobj, "SimulationClock", SimulationClockMode);
+	CopyOrDefaultRef(configobj, "RawFrameCache", RawFrameCacheSetting);
 
 	nlohmann::json &Capture = CopyOrDefaultJson(configobj, "Capture");
 	{
@@ -84,9 +90,27 @@ void InitConfig()
 		CopyOrDefaultRef(Capture, 		"Method", 			CaptureCfg.StartType);
 		CopyOrDefaultRef(Resolution, 	"Reduction", 		CaptureCfg.ReductionFactor);
 		CopyOrDefaultRef(Capture, 		"CameraFilter", 	CaptureCfg.filter);
+		CopyOrDefaultRef(Capture, 		"BufferCount", 		CaptureCfg.BufferCount);
+		CopyOrDefaultRef(Capture, 		"FrameWaitMs", 		CaptureCfg.FrameWaitMs);
 		
 	}
 
+	nlohmann::json &RecordingSett = CopyOrDefaultJson(configobj, "Recording");
+	{
+		CopyOrDefaultRef(RecordingSett, "QueueSize", 		RecordingCfg.QueueSize);
+		CopyOrDefaultRef(RecordingSett, "EncoderThreads", 	RecordingCfg.EncoderThreads);
+		CopyOrDefaultRef(RecordingSett, "DropPolicy", 		RecordingCfg.DropPolicy);
+		CopyOrDefaultRef(RecordingSett, "Container", 		RecordingCfg.Container);
+	}
+
+	nlohmann::json &YoloSett = CopyOrDefaultJson(configobj, "Yolo");
+	{
+		CopyOrDefaultRef(YoloSett, "Backend", 			YoloCfg.Backend);
+		CopyOrDefaultRef(YoloSett, "PreferQuantized", 	YoloCfg.PreferQuantized);
+		CopyOrDefaultRef(YoloSett, "FP16", 				YoloCfg.FP16);
+		CopyOrDefaultRef(YoloSett, "MaxBatchSize", 		YoloCfg.MaxBatchSize);
+	}
+
 	nlohmann::json &CamerasSett = CopyOrDefaultJson(configobj, "InternalCameras");
 	{
 		CamerasInternal.clear();
@@ -154,6 +178,30 @@ bool DoScreenCapture()
 	return ScreenCapture;
 }
 
+SimulationClock GetSimulationClock()
+{
+	InitConfig();
+	return (SimulationClock)SimulationClockMode;
+}
+
+void SetSimulationClock(SimulationClock Clock)
+{
+	InitConfig();
+	SimulationClockMode = (int)Clock;
+}
+
+RawFrameCacheMode GetRawFrameCacheMode()
+{
+	InitConfig();
+	return (RawFrameCacheMode)RawFrameCacheSetting;
+}
+
+chrono::steady_clock::time_point GetSimulationEpoch()
+{
+	static chrono::steady_clock::time_point Epoch = chrono::steady_clock::now();
+	return Epoch;
+}
+
 const aruco::ArucoDetector& GetArucoDetector(){
 	if (!HasDetector)
 	{
@@ -203,6 +251,18 @@ float GetReductionFactor()
 	return CaptureCfg.ReductionFactor;
 }
 
+const RecordingConfig& GetRecordingConfig()
+{
+	InitConfig();
+	return RecordingCfg;
+}
+
+const YoloConfig& GetYoloConfig()
+{
+	InitConfig();
+	return YoloCfg;
+}
+
 KeepAliveSettings GetKeepAliveSettings()
 {
 	InitConfig();
@@ -99,6 +99,18 @@ double GetRotZ(Matx33d rotation)
 	return atan2(Xaxis(1,0), Xaxis(0,0));
 }
 
+bool IsPoseClose(Affine3d A, Affine3d B, double MaxTranslation, double MaxRotation)
+{
+	Vec3d translation = B.translation() - A.translation();
+	if (translation.ddot(translation) > MaxTranslation*MaxTranslation)
+	{
+		return false;
+	}
+	Matx33d delta = A.rotation().t() * B.rotation();
+	double cosangle = (trace(delta) - 1) / 2;
+	return acos(min(max(cosangle, -1.0), 1.0)) <= MaxRotation;
+}
+
 Vec3d LinePlaneIntersection(Vec3d LineOrigin, Vec3d LineDirection, Vec3d PlaneOrigin, Vec3d PlaneNormal)
 {
 	LineDirection = NormaliseVector(LineDirection);
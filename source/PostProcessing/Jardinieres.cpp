@@ -1,5 +1,6 @@
 #include <PostProcessing/Jardinieres.hpp>
 #include <EntryPoints/CDFRExternal.hpp>
+#include <Cameras/FrameChanges.hpp>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/highgui.hpp>
 
@@ -72,6 +73,11 @@ PostProcessJardinieres::PostProcessJardinieres(CDFRExternal* InOwner)
 	}
 }
 
+bool PostProcessJardinieres::NeedsColorImage(size_t NumCameras) const
+{
+	return NumCameras == 1;
+}
+
 void PostProcessJardinieres::Process(std::vector<CameraImageData> &ImageData, std::vector<CameraFeatureData> &FeatureData, std::vector<ObjectData> &Objects)
 {
 	(void) ImageData;
@@ -104,33 +110,44 @@ void PostProcessJardinieres::Process(std::vector<CameraImageData> &ImageData, st
 		projectPoints(zone.Corners, InvCameraMatrix.rvec(), InvCameraMatrix.translation(), 
 			ThisFeatureData.CameraMatrix, ThisFeatureData.DistanceCoefficients, ImagePointsDouble);
 		vector<Vec2f> ImagePoints(ImagePointsDouble.begin(), ImagePointsDouble.end()-1);
-		
-		Mat WarpedImage, HSV; vector<Mat> BGRComponents, HSVComponents;
-		Mat AffineMatrix = getAffineTransform(ImagePoints, AffineTarget);
-		warpAffine(ThisImageData.Image, WarpedImage, AffineMatrix, WantedImageSize);
-		split(WarpedImage, BGRComponents);
-		cvtColor(WarpedImage, HSV, COLOR_BGR2HSV);
-		split(WarpedImage, HSVComponents);
-		Mat mask, green, notblue, notred, adaptive_value, adaptive_dilated, adaptive_eroded, saturated;
-		threshold(BGRComponents[1], green, 32, 255, THRESH_BINARY);
-		threshold(BGRComponents[0], notblue, 128, 255, THRESH_BINARY_INV);
-		threshold(BGRComponents[2], notred, 128, 255, THRESH_BINARY_INV);
-		adaptiveThreshold(HSVComponents[2], adaptive_value, 255, ADAPTIVE_THRESH_GAUSSIAN_C, THRESH_BINARY_INV, 3, 10);
-		dilate(adaptive_value, adaptive_dilated, dilation_kernel);
-		erode(adaptive_dilated, adaptive_eroded, erosion_kernel);
-		threshold(HSVComponents[1], saturated, 32, 255, THRESH_BINARY);
-		mask = green & notblue & notred & adaptive_eroded;
-		/*if (zone.name == "Bleu Sud")
+		vector<Point2f> AllImagePoints(ImagePointsDouble.begin(), ImagePointsDouble.end());
+		Rect region = boundingRect(AllImagePoints);
+		const auto &Changes = ThisImageData.Changes;
+		bool reuse = Changes && zone.LastFrame > 0 && region == zone.LastRegion
+			&& Changes->FrameIndex - zone.LastFrame < MaxReuseFrames
+			&& !Changes->HasChangedSince(region, zone.LastFrame);
+		if (!reuse)
 		{
-			Mat concat;
-			vector<Mat> masks{green, notblue, notred, adaptive_value, adaptive_dilated, adaptive_eroded, saturated, mask};
-			vconcat(masks, concat);
-			cvtColor(concat, concat, COLOR_GRAY2BGR);
-			masks = {WarpedImage, concat};
-			vconcat(masks, concat);
-			imshow(zone.name, concat);
-		}*/
-		int NumWhitePixels = countNonZero(mask);
+			Mat WarpedImage, HSV; vector<Mat> BGRComponents, HSVComponents;
+			Mat AffineMatrix = getAffineTransform(ImagePoints, AffineTarget);
+			warpAffine(ThisImageData.Image, WarpedImage, AffineMatrix, WantedImageSize);
+			split(WarpedImage, BGRComponents);
+			cvtColor(WarpedImage, HSV, COLOR_BGR2HSV);
+			split(WarpedImage, HSVComponents);
+			Mat mask, green, notblue, notred, adaptive_value, adaptive_dilated, adaptive_eroded, saturated;
+			threshold(BGRComponents[1], green, 32, 255, THRESH_BINARY);
+			threshold(BGRComponents[0], notblue, 128, 255, THRESH_BINARY_INV);
+			threshold(BGRComponents[2], notred, 128, 255, THRESH_BINARY_INV);
+			adaptiveThreshold(HSVComponents[2], adaptive_value, 255, ADAPTIVE_THRESH_GAUSSIAN_C, THRESH_BINARY_INV, 3, 10);
+			dilate(adaptive_value, adaptive_dilated, dilation_kernel);
+			erode(adaptive_dilated, adaptive_eroded, erosion_kernel);
+			threshold(HSVComponents[1], saturated, 32, 255, THRESH_BINARY);
+			mask = green & notblue & notred & adaptive_eroded;
+			/*if (zone.name == "Bleu Sud")
+			{
+				Mat concat;
+				vector<Mat> masks{green, notblue, notred, adaptive_value, adaptive_dilated, adaptive_eroded, saturated, mask};
+				vconcat(masks, concat);
+				cvtColor(concat, concat, COLOR_GRAY2BGR);
+				masks = {WarpedImage, concat};
+				vconcat(masks, concat);
+				imshow(zone.name, concat);
+			}*/
+			zone.NumWhitePixels = countNonZero(mask);
+			zone.LastRegion = region;
+			zone.LastFrame = Changes ? Changes->FrameIndex : 0;
+		}
+		int NumWhitePixels = zone.NumWhitePixels;
 		zone.NumPlants = NumWhitePixels * 12 / WantedImageSize.area();
 		//cout << zone.NumPlants << " plants in " << zone.name << endl;
 
@@ -163,11 +180,11 @@ void PostProcessJardinieres::Process(std::vector<CameraImageData> &ImageData, st
 		obj.metadata["whitePixels"] = NumWhitePixels;
 		if (zone.LastContactStart != ObjectData::TimePoint())
 		{
-			obj.metadata["lastContactStartAge"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Clock::now() - zone.LastContactStart).count();
+			obj.metadata["lastContactStartAge"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Now() - zone.LastContactStart).count();
 		}
 		if (zone.LastContactEnd != ObjectData::TimePoint())
 		{
-			obj.metadata["lastContactStopAge"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Clock::now() - zone.LastContactEnd).count();
+			obj.metadata["lastContactStopAge"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Now() - zone.LastContactEnd).count();
 		}
 		obj.metadata["contacting"] = zone.Contacting;
 		obj.metadata["timeSpentNear"] = chrono::duration_cast<chrono::milliseconds>(zone.TimeSpentContacting).count();
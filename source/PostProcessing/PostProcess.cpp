@@ -35,6 +35,12 @@ vector<ObjectData> PostProcess::GetEnemyRobots(vector<ObjectData> &Objects) cons
 	return robots;
 }
 
+bool PostProcess::NeedsColorImage(size_t NumCameras) const
+{
+	(void) NumCameras;
+	return false;
+}
+
 void PostProcess::Process(vector<CameraImageData> &ImageData, vector<CameraFeatureData> &FeatureData, vector<ObjectData> &Objects)
 {
 	(void) ImageData;
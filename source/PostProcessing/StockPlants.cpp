@@ -82,7 +82,7 @@ void PostProcessStockPlants::Process(std::vector<CameraImageData> &ImageData, st
 		obj.metadata["intact"] = intact;
 		if (!intact)
 		{
-			obj.metadata["ageContact"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Clock::now() - zone.LastTouched).count();
+			obj.metadata["ageContact"] = chrono::duration_cast<chrono::milliseconds>(ObjectData::Now() - zone.LastTouched).count();
 		}
 		
 		Objects.push_back(obj);
@@ -42,7 +42,7 @@ void PostProcessYoloDeflicker::Process(vector<CameraImageData> &ImageData, vecto
 		CachedObjects.emplace_back(obj);
 		numnew++;
 	}
-	auto time_threshold = ObjectData::Clock::now();
+	auto time_threshold = ObjectData::Now();
 	auto cache_erase_iterator = std::remove_if(CachedObjects.begin(), 
 		CachedObjects.end(),
 		[time_threshold](YoloObject &obj) { return !obj.Associated && (obj.Lifetime < time_threshold); });
@@ -45,7 +45,7 @@ bool ExternalImgui::DisplayFrame(CDFRExternal *Parent)
 	if ((int)Textures.size() != NumDisplays)
 	{
 		Textures.resize(NumDisplays);
-		LastMatrices.resize(NumDisplays, nullptr);
+		LastGrabTimes.resize(NumDisplays);
 	}
 	cv::Size WindowSize = GetWindowSize();
 	cv::Size ImageSize = WindowSize;
@@ -94,9 +94,18 @@ bool ExternalImgui::DisplayFrame(CDFRExternal *Parent)
 			//ImGui::Checkbox("Freeze camera position", nullptr);
 			ImGui::Checkbox("Aruco Detection", &entry.second.ArucoDetection);
 			ImGui::Checkbox("Distorted detection", &entry.second.DistortedDetection);
+			ImGui::Checkbox("Sparse undistortion", &entry.second.SparseUndistortion);
 			ImGui::Checkbox("Segmented detection", &entry.second.SegmentedDetection);
+			ImGui::Checkbox("Tracked detection", &entry.second.TrackedDetection);
+			ImGui::InputInt("Full scan interval", &entry.second.FullScanInterval);
+			ImGui::Checkbox("Full resolution refinement", &entry.second.FullResolutionRefinement);
+			ImGui::Checkbox("Shared threshold (fast 4x4 decode)", &entry.second.SharedThreshold);
+			ImGui::Checkbox("Board masking", &entry.second.BoardMasking);
+			ImGui::Checkbox("Geometric tiles", &entry.second.GeometricTiles);
+			ImGui::Checkbox("Change gating", &entry.second.ChangeGating);
 			ImGui::Checkbox("POI Detection", &entry.second.POIDetection);
 			ImGui::Checkbox("Yolo detection", &entry.second.YoloDetection);
+			ImGui::Checkbox("Async yolo", &entry.second.AsyncYolo);
 			ImGui::Checkbox("Denoising", &entry.second.Denoising);
 			ImGui::Spacing();
 		}
@@ -138,9 +147,9 @@ bool ExternalImgui::DisplayFrame(CDFRExternal *Parent)
 			thisTile.x = -POI.x+(WindowSize.width-POI.width)/2;
 			thisTile.y = -POI.y+(WindowSize.height-POI.height)/2;
 		}
-		if (LastMatrices[camidx*DisplaysPerCam] != ImData.Image.u)
+		if (LastGrabTimes[camidx*DisplaysPerCam] != ImData.GrabTime)
 		{
-			LastMatrices[camidx*DisplaysPerCam] = ImData.Image.u;
+			LastGrabTimes[camidx*DisplaysPerCam] = ImData.GrabTime;
 			Textures[camidx*DisplaysPerCam].LoadFromUMat(ImData.Image);
 		}
 		
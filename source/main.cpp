@@ -115,6 +115,7 @@ int main(int argc, char** argv )
 		"{calibrate c  |  | start camera calibration wizard}"
 		"{marker m     |  | print out markers}"
 		"{map          |  | runs object mapping, using saved images and calibration}"
+		"{benchmark    |  | play the scenario once as fast as possible, print throughput and timings, then exit}"
 		;
 	CommandLineParser parser(argc, argv, keys);
 
@@ -178,7 +179,13 @@ int main(int argc, char** argv )
 		
 	}
 
-	CDFRCommon::ExternalSettings.direct = parser.has("direct") ? parser.get<bool>("direct") : true;
+	if (parser.has("benchmark"))
+	{
+		SetSimulationClock(SimulationClock::Benchmark);
+	}
+	//playing a scenario once is meant to run headless
+	bool PlayOnce = GetScenario().size() && GetSimulationClock() != SimulationClock::Loop;
+	CDFRCommon::ExternalSettings.direct = parser.has("direct") ? parser.get<bool>("direct") : !PlayOnce;
 	CDFRCommon::ExternalSettings.v3d = parser.has("opengl") ? parser.get<bool>("opengl") : false;
 	CDFRCommon::ExternalSettings.record = parser.has("record");
 